@@ -12,14 +12,30 @@
 #include <chrono>
 #include <iostream>
 #include <algorithm>
+#include <limits>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <atomic>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define OWNER_SIMD // SSE2 kernels, AVX2 kernels if the cpu supports them (OwnerKernels)
+#include <immintrin.h>
+#endif
 
 #include "hlt.hpp"
 #include "networking.hpp"
 //#include "socket_networking.hpp"
 
 //#define DEBUG
+//#define RECORD
+//#define BENCHMARK
 #define FULLDEBUG 0
-bool active = false;
+
+const double FRAME_TIME_LIMIT = 1000; // ms per frame given by the environment
+const double FRAME_SAFETY_MARGIN = 50; // ms kept free for reading and sending the frame
 
 class Timer {
 public:
@@ -41,6 +57,10 @@ public:
 		return false;
 	}
 
+	double remainingInMilliSeconds() const {
+		return std::chrono::duration<double, std::milli>(m_timeOut - (std::chrono::high_resolution_clock::now() - m_startTime)).count();
+	}
+
 	std::chrono::milliseconds currentTimeTakenInMilliSeconds() const {
 		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - m_startTime);
 	}
@@ -56,365 +76,1628 @@ private:
 	bool m_started;
 };
 
-class Tile {
+// time budget of one frame, the phases get their share from a cost model of the recent frames
+// the model keeps the milliseconds per unit of work (map tiles, searches, own tiles per planner search, planned tiles) as moving average
+class FrameScheduler {
 public:
-	unsigned char x, y;
-	unsigned short id;
+	enum Phase { INGEST, SEARCH, PLANNER, PATHS, OVERKILL, PHASES };
+
+	FrameScheduler(double timeLimit = FRAME_TIME_LIMIT, double safetyMargin = FRAME_SAFETY_MARGIN) : m_deadline(timeLimit - safetyMargin),
+		m_costPerUnit{ { 0.001, 0.05, 0.0002, 0.05, 0.002 } }, m_phaseTime(), m_phase(INGEST), m_phaseStart() {}
+
+	void startFrame() {
+		m_timer.startTimer(m_deadline);
+		m_phaseTime.fill(0);
+	}
+	void startPhase(Phase phase) {
+		m_phase = phase;
+		m_phaseStart = std::chrono::high_resolution_clock::now();
+	}
+	// ends the current phase and learns its cost from the units of work done
+	void endPhase(size_t units) {
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_phaseStart).count();
+		m_phaseTime[m_phase] += ms;
+		if (units) {
+			m_costPerUnit[m_phase] += SMOOTHING * (ms / units - m_costPerUnit[m_phase]);
+		}
+	}
+	double predict(Phase phase, size_t units) const {
+		return m_costPerUnit[phase] * units;
+	}
+	// units of work of the phase which fit into the time
+	size_t affordable(Phase phase, double ms) const {
+		return ms > 0 ? (size_t)(ms / m_costPerUnit[phase]) : 0;
+	}
+	double remaining() const {
+		return m_timer.remainingInMilliSeconds();
+	}
+	// true if only the reserved time is left
+	bool exhausted(double reserve) const {
+		return remaining() <= reserve;
+	}
+	bool timeCheck() const {
+		return m_timer.timeCheck();
+	}
+	const Timer& timer() const {
+		return m_timer;
+	}
+	void print(std::ostream& out) const {
+		static const char* names[PHASES] = { "ingest", "search", "planner", "paths", "overkill" };
+		for (size_t p = 0; p < PHASES; p++) {
+			out << names[p] << ": " << std::fixed << std::setprecision(2) << m_phaseTime[p] << "ms (" << std::setprecision(4) << m_costPerUnit[p] << ") ";
+		}
+		out << std::defaultfloat;
+	}
+
+private:
+	static constexpr double SMOOTHING = 0.3; // weight of the last frame in the cost model
 
-	unsigned char owner;
-	unsigned char strength;
-	unsigned char production;
-	char move; // default -1
-
-	float sDivP; // strength / production
-	std::array<Tile*, 4> neighbours;
-	short used; // id of global path (one Tile can be associated with many paths but its strength and production can only be used once)
-
-	Tile() : x(0), y(0), id(0), owner(0), strength(0), production(0), move(-1), sDivP(0), used(-1) {
-	}
-	Tile(unsigned char x, unsigned char y, unsigned char o, unsigned char s, unsigned char p, unsigned char width) :
-		x(x), y(y),
-		id(y*width + x),
-		owner(o),
-		strength(s),
-		production(p),
-		move(-1),
-		used(-1)
+	Timer m_timer;
+	double m_deadline;
+	std::array<double, PHASES> m_costPerUnit;
+	std::array<double, PHASES> m_phaseTime; // ms of the current frame
+	Phase m_phase;
+	std::chrono::high_resolution_clock::time_point m_phaseStart;
+};
+
+// always on profiler: scoped timers of the bot sections and the search counters are recorded into a lock-free ring buffer
+// (threads of the pool record too), endFrame() sums up the records of a frame into one csv row per section
+class Profiler {
+public:
+	enum Section { INGEST, DIJKSTRA, PLANNER, ADJACENT_TILES, PATH_SEARCH, MOVE_EMISSION, SEND, SECTIONS };
+
+	struct Record {
+		unsigned char section;
+		unsigned int nanoseconds;
+		unsigned int relaxations;
+		unsigned int pushes;
+	};
+
+	Profiler() : m_ring(RING_SIZE), m_head(0), m_tail(0), m_frame(0), m_peakMemory(0), m_out(nullptr) {}
+
+	void record(Section section, unsigned int nanoseconds, unsigned int relaxations = 0, unsigned int pushes = 0) {
+		size_t i = m_head.fetch_add(1, std::memory_order_relaxed);
+		m_ring[i & (RING_SIZE - 1)] = { (unsigned char)section, nanoseconds, relaxations, pushes };
+	}
+	// heap bytes of the planning data, the peak of the frame is reported
+	void memory(size_t bytes) {
+		m_peakMemory = (std::max)(m_peakMemory, bytes);
+	}
+	// the rows of every frame are written (and flushed, the bot is killed at the end of the game) to out
+	void setOutput(std::ostream* out) {
+		m_out = out;
+		if (m_out) *m_out << "frame,section,count,total_us,max_us,relaxations,pushes,dropped,peak_kb" << std::endl;
+	}
+	// sums up the records since the last call, no records may be written concurrently
+	void endFrame() {
+		static const char* names[SECTIONS] = { "ingest", "dijkstra", "planner", "adjacent_tiles", "path_search", "move_emission", "send" };
+		struct Summary {
+			size_t count;
+			unsigned long long nanoseconds;
+			unsigned int maxNanoseconds;
+			unsigned long long relaxations;
+			unsigned long long pushes;
+		};
+		std::array<Summary, SECTIONS> summary = {};
+
+		size_t head = m_head.load(std::memory_order_acquire);
+		size_t dropped = head - m_tail > RING_SIZE ? head - m_tail - RING_SIZE : 0;
+		for (size_t i = m_tail + dropped; i < head; i++) {
+			const Record& r = m_ring[i & (RING_SIZE - 1)];
+			Summary& s = summary[r.section];
+			s.count++;
+			s.nanoseconds += r.nanoseconds;
+			s.maxNanoseconds = (std::max)(s.maxNanoseconds, r.nanoseconds);
+			s.relaxations += r.relaxations;
+			s.pushes += r.pushes;
+		}
+		m_tail = head;
+
+		if (m_out) {
+			for (size_t section = 0; section < SECTIONS; section++) {
+				const Summary& s = summary[section];
+				if (s.count == 0) continue;
+				*m_out << m_frame << "," << names[section] << "," << s.count << "," << s.nanoseconds / 1000 << "," << s.maxNanoseconds / 1000 << ","
+					<< s.relaxations << "," << s.pushes << "," << dropped << "," << m_peakMemory / 1024 << "\n";
+			}
+			m_out->flush();
+		}
+		m_frame++;
+		m_peakMemory = 0;
+	}
+
+private:
+	static const size_t RING_SIZE = 1 << 16; // records of one frame, power of 2
+
+	std::vector<Record> m_ring;
+	std::atomic<size_t> m_head; // next record to write
+	size_t m_tail; // next record to sum up
+	unsigned int m_frame;
+	size_t m_peakMemory;
+	std::ostream* m_out;
+};
+
+// records the time from construction to destruction of the scope
+class ProfileScope {
+private:
+	Profiler& m_profiler;
+	Profiler::Section m_section;
+	std::chrono::high_resolution_clock::time_point m_start;
+	unsigned int m_relaxations;
+	unsigned int m_pushes;
+public:
+	ProfileScope(Profiler& profiler, Profiler::Section section) : m_profiler(profiler), m_section(section), m_start(std::chrono::high_resolution_clock::now()), m_relaxations(0), m_pushes(0) {}
+	~ProfileScope() {
+		m_profiler.record(m_section, (unsigned int)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - m_start).count(), m_relaxations, m_pushes);
+	}
+	void count(unsigned int relaxations, unsigned int pushes) {
+		m_relaxations = relaxations;
+		m_pushes = pushes;
+	}
+};
+
+// persistent pool of worker threads, the calling thread works too
+// the tasks are split into chunks which are dealt to one deque per thread, idle threads steal chunks from the others
+class ThreadPool {
+private:
+	struct Chunk {
+		size_t begin;
+		size_t end;
+	};
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Chunk> chunks;
+	};
+	std::vector<std::thread> m_workers;
+	std::vector< std::unique_ptr<Queue> > m_queues; // one per worker, the last one belongs to the calling thread
+	std::function<void(size_t)> m_task;
+	std::mutex m_mutex;
+	std::condition_variable m_start;
+	std::condition_variable m_done;
+	size_t m_job; // counts the parallelFor calls, wakes up the workers
+	size_t m_busy; // workers still running the current job
+	bool m_stop;
+
+	bool popChunk(size_t self, Chunk& chunk) {
+		// own chunks from the back, stolen chunks from the front
+		for (size_t i = 0; i < m_queues.size(); i++) {
+			Queue& q = *m_queues[(self + i) % m_queues.size()];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if (!q.chunks.empty()) {
+				if (i == 0) {
+					chunk = q.chunks.back();
+					q.chunks.pop_back();
+				} else {
+					chunk = q.chunks.front();
+					q.chunks.pop_front();
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+	void work(size_t self) {
+		Chunk chunk;
+		while (popChunk(self, chunk)) {
+			for (size_t i = chunk.begin; i < chunk.end; i++) {
+				m_task(i);
+			}
+		}
+	}
+	void run(size_t self) {
+		size_t job = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_start.wait(lock, [this, job] { return m_stop || m_job != job; });
+				if (m_stop) return;
+				job = m_job;
+			}
+
+			work(self);
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_busy == 0) m_done.notify_one();
+		}
+	}
+public:
+	ThreadPool(size_t threads = (std::max)(std::thread::hardware_concurrency(), 1u)) : m_job(0), m_busy(0), m_stop(false) {
+		for (size_t i = 0; i < threads; i++) {
+			m_queues.emplace_back(new Queue());
+		}
+		for (size_t i = 0; i + 1 < threads; i++) {
+			m_workers.emplace_back(&ThreadPool::run, this, i);
+		}
+	}
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_start.notify_all();
+		for (std::thread& w : m_workers) {
+			w.join();
+		}
+	}
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t size() const {
+		return m_queues.size();
+	}
+
+	// task(i) for all i in [0, n), returns when all tasks are finished
+	void parallelFor(size_t n, size_t chunkSize, const std::function<void(size_t)>& task) {
+		chunkSize = (std::max)(chunkSize, (size_t)1);
+		if (m_workers.empty() || n <= chunkSize) {
+			for (size_t i = 0; i < n; i++) {
+				task(i);
+			}
+			return;
+		}
+
+		m_task = task;
+		size_t k = 0;
+		for (size_t begin = 0; begin < n; begin += chunkSize, k++) {
+			Queue& q = *m_queues[k % m_queues.size()];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			q.chunks.push_back({ begin, (std::min)(n, begin + chunkSize) });
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_busy = m_workers.size();
+			m_job++;
+		}
+		m_start.notify_all();
+
+		work(m_queues.size() - 1);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this] { return m_busy == 0; });
+	}
+};
+
+// torus topology of a map, computed once per map size and shared by all grids
+class Topology {
+public:
+	unsigned char width;
+	unsigned char height;
+	unsigned short size;
+	std::vector< std::array<unsigned short, 4> > neighbours; // NORTH, EAST, SOUTH, WEST
+
+	Topology(unsigned char w, unsigned char h) : width(w), height(h), size((unsigned short)(w*h)), neighbours(size) {
+		for (unsigned short id = 0; id < size; id++) {
+			unsigned char x = id % width, y = id / width;
+			neighbours[id][NORTH - 1] = (y == 0 ? height - 1 : y - 1) * width + x;
+			neighbours[id][EAST - 1] = y * width + (x == width - 1 ? 0 : x + 1);
+			neighbours[id][SOUTH - 1] = (y == height - 1 ? 0 : y + 1) * width + x;
+			neighbours[id][WEST - 1] = y * width + (x == 0 ? width - 1 : x - 1);
+		}
+	}
+
+	static std::shared_ptr<const Topology> get(unsigned char width, unsigned char height) {
+		static std::shared_ptr<const Topology> cached;
+		if (!cached || cached->width != width || cached->height != height) {
+			cached = std::make_shared<const Topology>(width, height);
+		}
+		return cached;
+	}
+};
+
+// whole map scans of the owner plane (one byte per tile), shared by GameState and OverkillBotExtended
+// the SSE2 and AVX2 versions are picked at runtime, the scalar versions are the reference
+class OwnerKernels {
+public:
+	enum Level { SCALAR, SSE2, AVX2 };
+
+	// adjacency flags of a tile
+	static const unsigned char OWN = 1; // owned by the player
+	static const unsigned char NEXT_TO_OTHER = 2; // a neighbour is not owned by the player (border of own tiles)
+	static const unsigned char NEXT_TO_ENEMY = 4; // a neighbour is owned by another player
+	static const unsigned char NEXT_TO_OWN = 8; // a neighbour is owned by the player (frontier of other tiles)
+
+	// best level of the cpu, can be lowered (benchmark)
+	static Level& level() {
+		static Level l = detect();
+		return l;
+	}
+
+	// tiles per owner, owners 0 ... 6
+	static void histogram(const unsigned char* owner, unsigned short size, unsigned int counts[7]) {
+		for (size_t p = 0; p < 7; p++) {
+			counts[p] = 0;
+		}
+		unsigned short i = 0;
+#ifdef OWNER_SIMD
+		if (level() == AVX2) i = histogramAVX2(owner, size, counts);
+		else if (level() == SSE2) i = histogramSSE2(owner, size, counts);
+#endif
+		for (; i < size; i++) {
+			counts[owner[i]]++;
+		}
+	}
+	// tiles of the owner id, sorted by id
+	static void tiles(const unsigned char* owner, unsigned short size, unsigned char id, std::vector<unsigned short>& out) {
+		out.clear();
+		unsigned short i = 0;
+#ifdef OWNER_SIMD
+		if (level() == AVX2) i = tilesAVX2(owner, size, id, out);
+		else if (level() == SSE2) i = tilesSSE2(owner, size, id, out);
+#endif
+		for (; i < size; i++) {
+			if (owner[i] == id) out.push_back(i);
+		}
+	}
+	// adjacency flags of all tiles for the player id
+	static void adjacency(const Topology& topology, const unsigned char* owner, unsigned char id, std::vector<unsigned char>& flags) {
+		flags.resize(topology.size);
+#ifdef OWNER_SIMD
+		if (level() != SCALAR) {
+			adjacencyPlane(topology, owner, id, flags.data());
+			return;
+		}
+#endif
+		for (unsigned short t = 0; t < topology.size; t++) {
+			flags[t] = adjacency(topology, owner, id, t);
+		}
+	}
+
+private:
+	static Level detect() {
+#ifdef OWNER_SIMD
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? AVX2 : SSE2;
+#else
+		return SCALAR;
+#endif
+	}
+	// OWN for own tiles, NEXT_TO_OTHER (and NEXT_TO_ENEMY) for the others, as seen by a neighbour
+	static inline unsigned char code(unsigned char o, unsigned char id) {
+		return o == id ? OWN : (o == 0 ? NEXT_TO_OTHER : NEXT_TO_OTHER | NEXT_TO_ENEMY);
+	}
+	static inline unsigned char flags(unsigned char self, unsigned char neighbours) {
+		return (self & OWN) | (neighbours & (NEXT_TO_OTHER | NEXT_TO_ENEMY)) | ((neighbours & OWN) << 3);
+	}
+	static unsigned char adjacency(const Topology& topology, const unsigned char* owner, unsigned char id, unsigned short t) {
+		unsigned char neighbours = 0;
+		for (unsigned short n : topology.neighbours[t]) {
+			neighbours |= code(owner[n], id);
+		}
+		return flags(code(owner[t], id), neighbours);
+	}
+#ifdef OWNER_SIMD
+	// the codes of the tiles with a copy of the last row before and of the first row after them,
+	// so the north and south neighbours are at -width and +width, east and west are wrong in the first and last column only
+	static void adjacencyPlane(const Topology& topology, const unsigned char* owner, unsigned char id, unsigned char* out) {
+		static thread_local std::vector<unsigned char> plane;
+		const unsigned short width = topology.width, size = topology.size;
+		plane.resize(size + 2 * width);
+		unsigned char* codes = plane.data() + width;
+		if (level() == AVX2) codesAVX2(owner, size, id, codes);
+		else codesSSE2(owner, size, id, codes);
+		std::copy(codes + size - width, codes + size, plane.data());
+		std::copy(codes, codes + width, codes + size);
+
+		if (level() == AVX2) flagsAVX2(codes, size, width, out);
+		else flagsSSE2(codes, size, width, out);
+		for (unsigned short t = 0; t < size; t += width) {
+			out[t] = adjacency(topology, owner, id, t);
+			out[t + width - 1] = adjacency(topology, owner, id, t + width - 1);
+		}
+	}
+	static void codesSSE2(const unsigned char* owner, unsigned short size, unsigned char id, unsigned char* codes) {
+		const __m128i idv = _mm_set1_epi8((char)id), zero = _mm_setzero_si128();
+		const __m128i own = _mm_set1_epi8(OWN), other = _mm_set1_epi8(NEXT_TO_OTHER), enemy = _mm_set1_epi8(NEXT_TO_ENEMY);
+		unsigned short i = 0;
+		for (; i + 16 <= size; i += 16) {
+			__m128i o = _mm_loadu_si128((const __m128i*)(owner + i));
+			__m128i isOwn = _mm_cmpeq_epi8(o, idv);
+			__m128i isEnemy = _mm_andnot_si128(_mm_or_si128(isOwn, _mm_cmpeq_epi8(o, zero)), enemy);
+			__m128i c = _mm_or_si128(_mm_and_si128(isOwn, own), _mm_or_si128(_mm_andnot_si128(isOwn, other), isEnemy));
+			_mm_storeu_si128((__m128i*)(codes + i), c);
+		}
+		for (; i < size; i++) {
+			codes[i] = code(owner[i], id);
+		}
+	}
+	static void flagsSSE2(const unsigned char* codes, unsigned short size, unsigned short width, unsigned char* out) {
+		const __m128i own = _mm_set1_epi8(OWN), others = _mm_set1_epi8(NEXT_TO_OTHER | NEXT_TO_ENEMY), nextToOwn = _mm_set1_epi8(NEXT_TO_OWN);
+		unsigned short i = 0;
+		for (; i + 16 <= size; i += 16) {
+			__m128i n = _mm_or_si128(_mm_or_si128(_mm_loadu_si128((const __m128i*)(codes + i - width)), _mm_loadu_si128((const __m128i*)(codes + i + width))),
+				_mm_or_si128(_mm_loadu_si128((const __m128i*)(codes + i - 1)), _mm_loadu_si128((const __m128i*)(codes + i + 1))));
+			__m128i f = _mm_or_si128(_mm_and_si128(_mm_loadu_si128((const __m128i*)(codes + i)), own), _mm_and_si128(n, others));
+			f = _mm_or_si128(f, _mm_and_si128(_mm_slli_epi16(n, 3), nextToOwn));
+			_mm_storeu_si128((__m128i*)(out + i), f);
+		}
+		for (; i < size; i++) {
+			out[i] = flags(codes[i], codes[i - width] | codes[i + width] | codes[i - 1] | codes[i + 1]);
+		}
+	}
+	static unsigned short histogramSSE2(const unsigned char* owner, unsigned short size, unsigned int counts[7]) {
+		unsigned short i = 0;
+		while (i + 16 <= size) {
+			// byte counters, summed up before they overflow
+			__m128i acc[7];
+			for (size_t p = 0; p < 7; p++) acc[p] = _mm_setzero_si128();
+			for (unsigned short blocks = 0; blocks < 255 && i + 16 <= size; blocks++, i += 16) {
+				__m128i o = _mm_loadu_si128((const __m128i*)(owner + i));
+				for (size_t p = 0; p < 7; p++) {
+					acc[p] = _mm_sub_epi8(acc[p], _mm_cmpeq_epi8(o, _mm_set1_epi8((char)p)));
+				}
+			}
+			for (size_t p = 0; p < 7; p++) {
+				__m128i s = _mm_sad_epu8(acc[p], _mm_setzero_si128());
+				counts[p] += (unsigned int)(_mm_cvtsi128_si32(s) + _mm_extract_epi16(s, 4));
+			}
+		}
+		return i;
+	}
+	static unsigned short tilesSSE2(const unsigned char* owner, unsigned short size, unsigned char id, std::vector<unsigned short>& out) {
+		const __m128i idv = _mm_set1_epi8((char)id);
+		unsigned short i = 0;
+		for (; i + 16 <= size; i += 16) {
+			unsigned int m = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(owner + i)), idv));
+			for (; m; m &= m - 1) {
+				out.push_back((unsigned short)(i + __builtin_ctz(m)));
+			}
+		}
+		return i;
+	}
+	__attribute__((target("avx2")))
+	static void codesAVX2(const unsigned char* owner, unsigned short size, unsigned char id, unsigned char* codes) {
+		const __m256i idv = _mm256_set1_epi8((char)id), zero = _mm256_setzero_si256();
+		const __m256i own = _mm256_set1_epi8(OWN), other = _mm256_set1_epi8(NEXT_TO_OTHER), enemy = _mm256_set1_epi8(NEXT_TO_ENEMY);
+		unsigned short i = 0;
+		for (; i + 32 <= size; i += 32) {
+			__m256i o = _mm256_loadu_si256((const __m256i*)(owner + i));
+			__m256i isOwn = _mm256_cmpeq_epi8(o, idv);
+			__m256i isEnemy = _mm256_andnot_si256(_mm256_or_si256(isOwn, _mm256_cmpeq_epi8(o, zero)), enemy);
+			__m256i c = _mm256_or_si256(_mm256_and_si256(isOwn, own), _mm256_or_si256(_mm256_andnot_si256(isOwn, other), isEnemy));
+			_mm256_storeu_si256((__m256i*)(codes + i), c);
+		}
+		for (; i < size; i++) {
+			codes[i] = code(owner[i], id);
+		}
+	}
+	__attribute__((target("avx2")))
+	static void flagsAVX2(const unsigned char* codes, unsigned short size, unsigned short width, unsigned char* out) {
+		const __m256i own = _mm256_set1_epi8(OWN), others = _mm256_set1_epi8(NEXT_TO_OTHER | NEXT_TO_ENEMY), nextToOwn = _mm256_set1_epi8(NEXT_TO_OWN);
+		unsigned short i = 0;
+		for (; i + 32 <= size; i += 32) {
+			__m256i n = _mm256_or_si256(_mm256_or_si256(_mm256_loadu_si256((const __m256i*)(codes + i - width)), _mm256_loadu_si256((const __m256i*)(codes + i + width))),
+				_mm256_or_si256(_mm256_loadu_si256((const __m256i*)(codes + i - 1)), _mm256_loadu_si256((const __m256i*)(codes + i + 1))));
+			__m256i f = _mm256_or_si256(_mm256_and_si256(_mm256_loadu_si256((const __m256i*)(codes + i)), own), _mm256_and_si256(n, others));
+			f = _mm256_or_si256(f, _mm256_and_si256(_mm256_slli_epi16(n, 3), nextToOwn));
+			_mm256_storeu_si256((__m256i*)(out + i), f);
+		}
+		for (; i < size; i++) {
+			out[i] = flags(codes[i], codes[i - width] | codes[i + width] | codes[i - 1] | codes[i + 1]);
+		}
+	}
+	__attribute__((target("avx2")))
+	static unsigned short histogramAVX2(const unsigned char* owner, unsigned short size, unsigned int counts[7]) {
+		unsigned short i = 0;
+		while (i + 32 <= size) {
+			__m256i acc[7];
+			for (size_t p = 0; p < 7; p++) acc[p] = _mm256_setzero_si256();
+			for (unsigned short blocks = 0; blocks < 255 && i + 32 <= size; blocks++, i += 32) {
+				__m256i o = _mm256_loadu_si256((const __m256i*)(owner + i));
+				for (size_t p = 0; p < 7; p++) {
+					acc[p] = _mm256_sub_epi8(acc[p], _mm256_cmpeq_epi8(o, _mm256_set1_epi8((char)p)));
+				}
+			}
+			for (size_t p = 0; p < 7; p++) {
+				__m256i s = _mm256_sad_epu8(acc[p], _mm256_setzero_si256());
+				counts[p] += (unsigned int)(_mm256_extract_epi64(s, 0) + _mm256_extract_epi64(s, 1) + _mm256_extract_epi64(s, 2) + _mm256_extract_epi64(s, 3));
+			}
+		}
+		return i;
+	}
+	__attribute__((target("avx2")))
+	static unsigned short tilesAVX2(const unsigned char* owner, unsigned short size, unsigned char id, std::vector<unsigned short>& out) {
+		const __m256i idv = _mm256_set1_epi8((char)id);
+		unsigned short i = 0;
+		for (; i + 32 <= size; i += 32) {
+			unsigned int m = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(owner + i)), idv));
+			for (; m; m &= m - 1) {
+				out.push_back((unsigned short)(i + __builtin_ctz(m)));
+			}
+		}
+		return i;
+	}
+#endif
+};
+// flat game map, one column per tile attribute (structure of arrays), tiles are addressed by id = y*width + x
+class Grid {
+public:
+	std::shared_ptr<const Topology> topology;
+	unsigned char width;
+	unsigned char height;
+	unsigned short size;
+
+	std::vector<unsigned char> owner;
+	std::vector<unsigned char> strength;
+	std::vector<unsigned char> production;
+	std::vector<signed char> move; // default -1
+	std::vector<short> used; // id of global path (one tile can be associated with many paths but its strength and production can only be used once)
+	std::vector<unsigned short> incoming; // strength of the tiles moving into the tile (ledger of setMove)
+	unsigned char maxProduction; // largest edge cost of the searches
+
+	// enemy field of one player, computed once per frame from the owners and strengths (computeEnemyField)
+	unsigned char fieldId; // player of the field, 0 if not computed
+	std::vector<unsigned char> adjacency; // OwnerKernels flags
+	std::vector< std::array<unsigned char, 4> > enemyStrength; // strength of the enemy neighbours (NORTH ... WEST), 0 for the other neighbours
+	std::array<unsigned int, 7> threat; // per player: strength of its tiles next to own tiles
+
+	class TilePrinter {
+	public:
+		const Grid& grid;
+		unsigned short id;
+
+		TilePrinter(const Grid& g, unsigned short i) : grid(g), id(i) {}
+
+		friend std::ostream& operator<<(std::ostream& os, const TilePrinter& tile) {
+			const Grid& g = tile.grid;
+			os << std::setw(4) << tile.id << " x:" << std::setw(2) << (int)g.x(tile.id) << " y:" << std::setw(2) << (int)g.y(tile.id) << " o:"
+				<< (int)g.owner[tile.id] << " s:" << std::setw(3) << (int)g.strength[tile.id] << " p:" << std::setw(3) << (int)g.production[tile.id]
+				<< " m:" << std::setw(2) << (int)g.move[tile.id] << " " << " u:" << std::setw(2) << (int)g.used[tile.id];
+			return os;
+		}
+	};
+
+	Grid() : width(0), height(0), size(0), maxProduction(0), fieldId(0), threat() {}
+	Grid(const hlt::GameMap& gameMap) : topology(Topology::get((unsigned char)gameMap.width, (unsigned char)gameMap.height)),
+		width((unsigned char)gameMap.width), height((unsigned char)gameMap.height), size(topology->size),
+		owner(size), strength(size), production(size), move(size, -1), used(size, -1), incoming(size, 0), maxProduction(0), fieldId(0), threat()
 	{
-		sDivP = production == 0 ? 1000 : float(strength) / production;
+		for (unsigned short id = 0; id < size; id++) {
+			const hlt::Site& s = gameMap.contents[y(id)][x(id)];
+			owner[id] = (unsigned char)s.owner;
+			strength[id] = (unsigned char)s.strength;
+			production[id] = (unsigned char)s.production;
+			maxProduction = (std::max)(maxProduction, production[id]);
+		}
 	}
 
-	bool operator==(const Tile& t) const  {
-		return id == t.id;
+	inline unsigned char x(unsigned short id) const {
+		return id % width;
+	}
+	inline unsigned char y(unsigned short id) const {
+		return id / width;
+	}
+	inline const std::array<unsigned short, 4>& neighbours(unsigned short id) const {
+		return topology->neighbours[id];
+	}
+	inline unsigned short getTile(unsigned short id, unsigned char direction = STILL) const {
+		return direction == STILL ? id : topology->neighbours[id][direction - 1];
+	}
+	inline unsigned short cost(unsigned short id) const {
+		return production[id];
+	}
+	void computeEnemyField(unsigned char id) {
+		fieldId = id;
+		OwnerKernels::adjacency(*topology, owner.data(), id, adjacency);
+		enemyStrength.resize(size);
+		threat.fill(0);
+		for (unsigned short t = 0; t < size; t++) {
+			std::array<unsigned char, 4>& e = enemyStrength[t];
+			if (adjacency[t] & OwnerKernels::NEXT_TO_ENEMY) {
+				for (size_t d = 0; d < 4; d++) {
+					unsigned short n = neighbours(t)[d];
+					e[d] = owner[n] != 0 && owner[n] != id ? strength[n] : 0;
+				}
+			} else {
+				e.fill(0);
+			}
+			if ((adjacency[t] & OwnerKernels::NEXT_TO_OWN) && owner[t] != id) {
+				threat[owner[t]] += strength[t];
+			}
+		}
+	}
+	// damage of the enemies next to t to a piece of strength s on t (each enemy deals at most s)
+	inline unsigned short damage(unsigned short t, unsigned char s) const {
+		const std::array<unsigned char, 4>& e = enemyStrength[t];
+		return (unsigned short)((std::min)(e[0], s) + (std::min)(e[1], s) + (std::min)(e[2], s) + (std::min)(e[3], s));
 	}
-	
-	void update(signed char o, unsigned char s) {
-		owner = o;
-		strength = s;
-		sDivP = production == 0 ? 1000 : float(strength) / production;
-		move = -1;
-		used = -1;
+	inline bool touchesEnemy(unsigned short t) const {
+		return (adjacency[t] & OwnerKernels::NEXT_TO_ENEMY) != 0;
 	}
-	inline unsigned short cost() {
-		return production;
+	// the per frame columns of another grid of the same map, topology and production are kept (storage is reused)
+	void assignState(const Grid& other) {
+		owner = other.owner;
+		strength = other.strength;
+		move = other.move;
+		used = other.used;
+		incoming = other.incoming;
+		fieldId = other.fieldId;
+		adjacency = other.adjacency;
+		enemyStrength = other.enemyStrength;
+		threat = other.threat;
+	}
+	void update(unsigned short id, unsigned char o, unsigned char s) {
+		owner[id] = o;
+		strength[id] = s;
+		move[id] = -1;
+		used[id] = -1;
+		incoming[id] = 0;
+	}
+	// all moves of a frame are set here, so the incoming strengths stay up to date (releases and commits in O(1))
+	inline void setMove(unsigned short t, signed char direction) {
+		if (move[t] > STILL) incoming[getTile(t, move[t])] -= strength[t];
+		move[t] = direction;
+		if (direction > STILL) incoming[getTile(t, direction)] += strength[t];
+	}
+	TilePrinter print(unsigned short id) const {
+		return TilePrinter(*this, id);
 	}
 
-	friend std::ostream& operator<<(std::ostream& os, const Tile& tile) {
-		os << std::setw(4) << tile.id << " x:" << std::setw(2) << (int)tile.x << " y:" << std::setw(2) << (int)tile.y << " o:"
-			<< (int)tile.owner << " s:" << std::setw(3) << (int)tile.strength << " p:" << std::setw(3) << (int)tile.production
-			<< " m:" << std::setw(2) << (int)tile.move << " " << " u:" << std::setw(2) << (int)tile.used;
-			// << " " << std::setw(5) << std::fixed << std::setprecision(2) << tile.sDivP;
-		return os;
+	void printMap(std::ostream& out) const {
+		out << "   ";
+		for (size_t j = 0; j < width; j++) {
+			out << "| " << std::setw(2) << j << " ";
+		}
+		out << "|" << std::endl;
+		out << "---";
+		for (size_t j = 0; j < width; j++) {
+			out << "-----";
+		}
+		out << "-" << std::endl;
+		for (size_t i = 0; i < height; i++) {
+			out << "   ";
+			for (size_t j = 0; j < width; j++) {
+				out << "|" << std::setw(4) << (int)(i*width + j);
+			}
+			out << "|" << std::endl;
+
+			out << std::setw(2) << i << " ";
+			for (size_t j = 0; j < width; j++) {
+				out << "|" << std::setw(1) << (int)owner[i*width + j] << "/" << std::setw(2) << (int)production[i*width + j];
+			}
+			out << "|" << std::endl;
+
+			out << "   ";
+			for (size_t j = 0; j < width; j++) {
+				out << "|" << std::setw(4) << (int)strength[i*width + j];
+			}
+			out << "|" << std::endl;
+
+			out << "---";
+			for (size_t j = 0; j < width; j++) {
+				out << "-----";
+			}
+			out << "-" << std::endl;
+		}
+	}
+};
+// one bit per tile
+class TileBitset {
+private:
+	std::vector<unsigned long long> m_bits;
+public:
+	void resize(unsigned short size) {
+		m_bits.assign((size + 63) / 64, 0);
+	}
+	void clear() {
+		std::fill(m_bits.begin(), m_bits.end(), 0);
+	}
+	inline bool test(unsigned short t) const {
+		return (m_bits[t >> 6] >> (t & 63)) & 1;
+	}
+	inline void set(unsigned short t) {
+		m_bits[t >> 6] |= 1ull << (t & 63);
+	}
+	inline void reset(unsigned short t) {
+		m_bits[t >> 6] &= ~(1ull << (t & 63));
+	}
+	size_t memory() const {
+		return m_bits.capacity() * sizeof(unsigned long long);
+	}
+	bool operator==(const TileBitset& other) const {
+		return m_bits == other.m_bits;
+	}
+	bool operator!=(const TileBitset& other) const {
+		return m_bits != other.m_bits;
+	}
+};
+// order in which GameState::computeMoves plans the tiles: indexed binary heap keyed by (batch, strength desc, id)
+// tiles pushed together form a batch, batches are planned in the order of their pushes, a tile is queued at most once
+class MoveScheduler {
+public:
+	struct Entry {
+		unsigned int batch;
+		unsigned char strength;
+		unsigned short id;
+
+		bool operator<(const Entry& e) const {
+			if (batch != e.batch) return batch < e.batch;
+			if (strength != e.strength) return strength > e.strength;
+			return id < e.id;
+		}
+	};
+private:
+	std::vector<Entry> m_heap;
+	std::vector<int> m_position; // index in the heap per tile, -1 if not queued
+	unsigned int m_batch;
+	size_t m_operations; // pushes, pops and heap moves since the last reset
+
+	void place(size_t i, const Entry& e) {
+		m_heap[i] = e;
+		m_position[e.id] = (int)i;
+		m_operations++;
+	}
+	void siftUp(size_t i) {
+		Entry e = m_heap[i];
+		while (i > 0 && e < m_heap[(i - 1) / 2]) {
+			place(i, m_heap[(i - 1) / 2]);
+			i = (i - 1) / 2;
+		}
+		place(i, e);
+	}
+	void siftDown(size_t i) {
+		Entry e = m_heap[i];
+		for (size_t c = 2 * i + 1; c < m_heap.size(); i = c, c = 2 * i + 1) {
+			if (c + 1 < m_heap.size() && m_heap[c + 1] < m_heap[c]) c++;
+			if (!(m_heap[c] < e)) break;
+			place(i, m_heap[c]);
+		}
+		place(i, e);
+	}
+public:
+	MoveScheduler() : m_batch(0), m_operations(0) {}
+
+	void reset(unsigned short size) {
+		if (m_position.size() != size) {
+			m_position.assign(size, -1);
+		}
+		for (const Entry& e : m_heap) {
+			m_position[e.id] = -1;
+		}
+		m_heap.clear();
+		m_batch = 0;
+		m_operations = 0;
+	}
+	// the following pushes are planned after all tiles pushed so far
+	void nextBatch() {
+		m_batch++;
+	}
+	bool empty() const {
+		return m_heap.empty();
+	}
+	bool contains(unsigned short t) const {
+		return m_position[t] != -1;
+	}
+	// tiles which are already queued keep their place
+	void push(unsigned short t, unsigned char strength) {
+		if (contains(t)) return;
+		m_heap.push_back({ m_batch, strength, t });
+		siftUp(m_heap.size() - 1);
+	}
+	unsigned short pop() {
+		unsigned short t = m_heap[0].id;
+		m_position[t] = -1;
+		Entry last = m_heap.back();
+		m_heap.pop_back();
+		if (!m_heap.empty()) {
+			m_heap[0] = last;
+			siftDown(0);
+		}
+		m_operations++;
+		return t;
+	}
+	size_t operations() const {
+		return m_operations;
+	}
+	// in heap order
+	const std::vector<Entry>& entries() const {
+		return m_heap;
 	}
 };
 class TileChanged {
 public:
-	Tile* ref;
+	unsigned short id;
 	unsigned char changed; // new own tile ... 1, removed tile ... 2
 
-	TileChanged(Tile& tile, unsigned char c) : ref(&tile), changed(c) {}
+	TileChanged(unsigned short i, unsigned char c) : id(i), changed(c) {}
 
-	friend std::ostream& operator<<(std::ostream& os, const TileChanged& tile) {
-		os << std::setw(4) << tile.ref->id << " changed:" << std::setw(4) << (tile.changed==1?" new":" cha") << " o:" << (int)tile.ref->owner
-			<< " s:" << std::setw(3) << (int)tile.ref->strength << " p:" << std::setw(3) << (int)tile.ref->production << " "
-			<< std::setw(5) << std::fixed << std::setprecision(2) << tile.ref->sDivP;
-		return os;
+	void print(std::ostream& os, const Grid& grid) const {
+		os << std::setw(4) << id << " changed:" << std::setw(4) << (changed == 1 ? " new" : " cha") << " o:" << (int)grid.owner[id]
+			<< " s:" << std::setw(3) << (int)grid.strength[id] << " p:" << std::setw(3) << (int)grid.production[id];
+	}
+};
+// owner changes of one frame, the bookkeeping of GameState is updated from these alone
+// (strength changes on almost every own tile each frame, so it is written to the grid directly)
+class FrameChanges {
+public:
+	struct OwnerFlip {
+		unsigned short id;
+		unsigned char from;
+		unsigned char to;
+	};
+	std::vector<OwnerFlip> owners;
+	std::vector<TileChanged> ownTiles; // new own tiles (sorted by id) followed by removed own tiles (sorted by id)
+};
+// reads the frames of the engine into a reused line buffer and decodes them straight into the grid,
+// the owner changes are collected on the way (replaces getFrame and its hlt::GameMap copy)
+class FrameDecoder {
+private:
+	std::string m_line;
+
+	static inline unsigned int parse(const char*& p) {
+		while (*p == ' ') p++;
+		if (*p < '0' || *p > '9') throw std::runtime_error("Malformed frame");
+		unsigned int v = 0;
+		while (*p >= '0' && *p <= '9') {
+			v = v * 10 + (*p++ - '0');
+		}
+		return v;
+	}
+public:
+	// false at the end of the input
+	bool read(std::istream& in) {
+		return (bool)std::getline(in, m_line);
+	}
+	const std::string& line() const {
+		return m_line;
+	}
+	// owner runs, then the strengths in tile order
+	void decode(Grid& grid, std::vector<FrameChanges::OwnerFlip>& owners) const {
+		const char* p = m_line.c_str();
+		unsigned short id = 0;
+		while (id < grid.size) {
+			unsigned int counter = parse(p);
+			unsigned char owner = (unsigned char)parse(p);
+			unsigned short end = (unsigned short)(std::min)((unsigned int)grid.size, id + counter);
+			for (; id < end; id++) {
+				if (grid.owner[id] != owner) {
+					owners.push_back({ id, grid.owner[id], owner });
+					grid.owner[id] = owner;
+				}
+			}
+		}
+		for (id = 0; id < grid.size; id++) {
+			grid.strength[id] = (unsigned char)parse(p);
+		}
+		std::fill(grid.move.begin(), grid.move.end(), -1);
+		std::fill(grid.used.begin(), grid.used.end(), -1);
+		std::fill(grid.incoming.begin(), grid.incoming.end(), 0);
+	}
+};
+// moves of one frame, flat by tile, the moving tiles are listed for the output
+// (replaces std::set<hlt::Move> and sendFrame, the buffers are allocated once)
+class MoveBuffer {
+private:
+	std::vector<unsigned char> m_direction; // STILL for tiles without a move
+	std::vector<unsigned short> m_moving; // tiles in the order of their first move
+	TileBitset m_listed; // tiles in m_moving, each tile is listed once even if it is set back to STILL and moved again
+	std::vector<char> m_output; // line for the environment
+	unsigned char m_width;
+
+	static inline char* writeNumber(char* p, unsigned int v) {
+		if (v >= 100) *p++ = (char)('0' + v / 100);
+		if (v >= 10) *p++ = (char)('0' + v / 10 % 10);
+		*p++ = (char)('0' + v % 10);
+		return p;
+	}
+public:
+	MoveBuffer() : m_width(0) {}
+
+	// all tiles STILL, O(moves of the last frame)
+	void reset(const Topology& topology) {
+		if (m_direction.size() != topology.size) {
+			m_direction.assign(topology.size, STILL);
+			m_listed.resize(topology.size);
+			m_moving.reserve(topology.size);
+			m_output.resize(topology.size * 10 + 1); // "xxx yyy d " per tile and the newline
+		} else {
+			for (unsigned short t : m_moving) {
+				m_direction[t] = STILL;
+				m_listed.reset(t);
+			}
+		}
+		m_moving.clear();
+		m_width = topology.width;
+	}
+	inline void set(unsigned short t, unsigned char direction) {
+		if (direction != STILL && !m_listed.test(t)) {
+			m_listed.set(t);
+			m_moving.push_back(t);
+		}
+		m_direction[t] = direction;
+	}
+	inline unsigned char direction(unsigned short t) const {
+		return m_direction[t];
+	}
+	// may contain tiles set back to STILL
+	const std::vector<unsigned short>& moving() const {
+		return m_moving;
+	}
+	// "x y direction " per moving tile, written with one call
+	void send(std::ostream& os) {
+		char* p = m_output.data();
+		for (unsigned short t : m_moving) {
+			if (m_direction[t] == STILL) continue;
+			p = writeNumber(p, t % m_width);
+			*p++ = ' ';
+			p = writeNumber(p, t / m_width);
+			*p++ = ' ';
+			*p++ = (char)('0' + m_direction[t]);
+			*p++ = ' ';
+		}
+		*p++ = '\n';
+		os.write(m_output.data(), p - m_output.data());
+		os.flush();
+	}
+};
+// frame scoped storage of all paths, reset in O(1) at the start of a frame
+// the blocks are kept over the frames and never move, so spans into them stay valid until the next reset
+class PathArena {
+private:
+	struct Block {
+		std::unique_ptr<unsigned short[]> tiles;
+		size_t capacity;
+	};
+	static const size_t BLOCK_SIZE = 1 << 14;
+	std::vector<Block> m_blocks;
+	size_t m_block; // current block
+	size_t m_used; // tiles used in the current block
+
+public:
+	PathArena() : m_block(0), m_used(0) {}
+
+	void reset() {
+		m_block = 0;
+		m_used = 0;
+	}
+	// contiguous memory for n tiles
+	unsigned short* allocate(size_t n) {
+		while (m_block < m_blocks.size() && m_used + n > m_blocks[m_block].capacity) {
+			m_block++;
+			m_used = 0;
+		}
+		if (m_block == m_blocks.size()) {
+			size_t capacity = (std::max)((size_t)BLOCK_SIZE, n);
+			m_blocks.push_back({ std::unique_ptr<unsigned short[]>(new unsigned short[capacity]), capacity });
+		}
+		unsigned short* tiles = m_blocks[m_block].tiles.get() + m_used;
+		m_used += n;
+		return tiles;
+	}
+	size_t memory() const {
+		size_t bytes = 0;
+		for (const Block& b : m_blocks) {
+			bytes += b.capacity * sizeof(unsigned short);
+		}
+		return bytes;
+	}
+};
+
+// path from start to target in the PathArena
+class PathSpan {
+private:
+	const unsigned short* m_tiles;
+	unsigned short m_size;
+public:
+	PathSpan() : m_tiles(nullptr), m_size(0) {}
+	PathSpan(const unsigned short* tiles, size_t size) : m_tiles(tiles), m_size((unsigned short)size) {}
+
+	unsigned short operator[](size_t i) const {
+		return m_tiles[i];
+	}
+	size_t size() const {
+		return m_size;
+	}
+	bool empty() const {
+		return m_size == 0;
+	}
+	unsigned short back() const {
+		return m_tiles[m_size - 1];
+	}
+	const unsigned short* begin() const {
+		return m_tiles;
+	}
+	const unsigned short* end() const {
+		return m_tiles + m_size;
 	}
 };
+
 class AdjacentTile {
 private:
-	unsigned short getPathProduction() {
+	unsigned short getPathProduction(const Grid& grid) {
 		unsigned short prod = 0;
 		for (size_t i = 1; i < m_path.size() - 1; i++) {
-			prod += m_path[i]->production;
+			prod += grid.production[m_path[i]];
 		}
 		return prod;
 	}
+	// sum: production of the tiles between start and target
+	void computeValue(const Grid& grid, unsigned short sum, float penalty) {
+		m_value = grid.strength[m_target] + sum + penalty * (std::max)((unsigned int)0, (unsigned int)(m_dist-1));
+		// only incoporate enemy tiles if next to
+		// global best and local best
+		if (m_dist == 1) {
+			m_value -= grid.damage(m_target, grid.strength[m_start]);
+		}
+		m_value /= m_production;
+	}
 public:
-	Tile* m_start;
-	Tile* m_target;
+	unsigned short m_start;
+	unsigned short m_target;
+	unsigned char m_production; // production of the target
 	unsigned short m_dist;
-	std::vector<Tile*> m_path;
+	PathSpan m_path;
 	float m_value;
 
-	AdjacentTile() : m_start(nullptr), m_target(nullptr), m_dist(-1), m_value(-1) {}
-	AdjacentTile(Tile* start, Tile* target, unsigned short dist, std::vector<Tile*>& path, float penalty, unsigned char id) : m_start(start), m_target(target), m_dist(dist), m_path(path){
-		unsigned short sum = getPathProduction();
-		m_value = m_target->strength + sum + penalty * (std::max)((unsigned int)0, (unsigned int)(path.size()-2));
-		// only incoporate enemy tiles if next to
-		// global best and local best
-		if (m_path.size() == 2) {
-			unsigned short damage = 0;
-			for (Tile* t : m_target->neighbours) {
-				if (t->owner != 0 && t->owner != id) {
-					damage += (std::min)(t->strength, m_start->strength);
-				}
-			}
-			m_value -= damage;
-		}
-		m_value /= m_target->production;
+	AdjacentTile() : m_start(-1), m_target(-1), m_production(0), m_dist(-1), m_value(-1) {}
+	AdjacentTile(const Grid& grid, unsigned short start, unsigned short target, unsigned short dist, PathSpan path, float penalty) :
+		m_start(start), m_target(target), m_production(grid.production[target]), m_dist(dist), m_path(path)
+	{
+		computeValue(grid, getPathProduction(grid), penalty);
+	}
+	// without path, the value comes from the production along the path (pathProduction), the path is set when the tile is taken
+	AdjacentTile(const Grid& grid, unsigned short start, unsigned short target, unsigned short dist, unsigned short pathProduction, float penalty) :
+		m_start(start), m_target(target), m_production(grid.production[target]), m_dist(dist)
+	{
+		computeValue(grid, pathProduction, penalty);
 	}
 
 	bool operator<(const AdjacentTile& t) const {
 		if (m_value != t.m_value) {
 			return m_value < t.m_value;
 		} else {
-			if (m_target->production != t.m_target->production) {
-				return m_target->production > t.m_target->production;
+			if (m_production != t.m_production) {
+				return m_production > t.m_production;
 			} else {
 				return m_dist < t.m_dist;
 			}
 		}
 	}
 
-	friend std::ostream& operator<<(std::ostream& os, const AdjacentTile& a) {
-		os << *(a.m_target) << " dist:" << std::setw(4) << (int)a.m_dist << " value:" << std::setw(5) << std::fixed << std::setprecision(2) << a.m_value << " path:";
-		for (Tile* t : a.m_path) {
-			os << t->id << "|";
+	void print(std::ostream& os, const Grid& grid) const {
+		os << grid.print(m_target) << " dist:" << std::setw(4) << (int)m_dist << " value:" << std::setw(5) << std::fixed << std::setprecision(2) << m_value << " path:";
+		for (unsigned short t : m_path) {
+			os << t << "|";
 		}
-		return os;
 	}
 };
-class DijkstraSearch {
+// monotone bucket queue (Dial's algorithm) for small integer edge costs
+// popped keys never decrease, keys within maxStep of the current key go into a circular bucket array (FIFO per bucket),
+// keys further away (e.g. the start tiles of an incremental search) wait in an overflow heap
+template<typename T>
+class BucketQueue {
 private:
-	std::vector<unsigned short> distMap;
-#if FULLDEBUG
-	std::map<unsigned short, Tile*> cameFrom;
-	std::map<unsigned short, unsigned short> costSoFar;
-	std::map<unsigned short, Tile*> adjacentTiles;
-#else
-	std::unordered_map<unsigned short, Tile*> cameFrom;
-	std::unordered_map<unsigned short, unsigned short> costSoFar;
-	std::unordered_map<unsigned short, Tile*> adjacentTiles;
+	std::vector< std::vector<T> > m_buckets; // bucket of key k is k % m_buckets.size()
+	std::vector< std::pair<unsigned int, T> > m_overflow; // min heap
+	unsigned int m_key; // key of the current bucket
+	size_t m_head; // read position in the current bucket
+	size_t m_size;
+
+	void refill() {
+		unsigned int last = m_key + (unsigned int)m_buckets.size() - 1;
+		while (!m_overflow.empty() && m_overflow.front().first <= last) {
+			m_buckets[m_overflow.front().first % m_buckets.size()].push_back(m_overflow.front().second);
+			std::pop_heap(m_overflow.begin(), m_overflow.end(), std::greater<std::pair<unsigned int, T>>());
+			m_overflow.pop_back();
+		}
+	}
+public:
+	BucketQueue() : m_key(0), m_head(0), m_size(0) {}
+
+	void reset(unsigned short maxStep) {
+		if (m_buckets.size() != (size_t)maxStep + 1) {
+			m_buckets.resize((size_t)maxStep + 1);
+		}
+		for (std::vector<T>& b : m_buckets) {
+			b.clear();
+		}
+		m_overflow.clear();
+		m_key = 0;
+		m_head = 0;
+		m_size = 0;
+	}
+	inline bool empty() const {
+		return m_size == 0;
+	}
+	// key of the last popped value
+	inline unsigned int key() const {
+		return m_key;
+	}
+	inline void push(unsigned int key, const T& value) {
+		m_size++;
+		if (key < m_key + m_buckets.size()) {
+			m_buckets[key % m_buckets.size()].push_back(value);
+		} else {
+			m_overflow.push_back(std::make_pair(key, value));
+			std::push_heap(m_overflow.begin(), m_overflow.end(), std::greater<std::pair<unsigned int, T>>());
+		}
+	}
+	T pop() {
+		for (;;) {
+			std::vector<T>& bucket = m_buckets[m_key % m_buckets.size()];
+			if (m_head < bucket.size()) {
+				m_size--;
+				return bucket[m_head++];
+			}
+			bucket.clear();
+			m_head = 0;
+			if (m_size == m_overflow.size()) { // all buckets are empty, jump to the next overflow key
+				m_key = m_overflow.front().first;
+			} else {
+				m_key++;
+			}
+			refill();
+		}
+	}
+};
+#ifdef BENCHMARK
+// binary heap with the interface of BucketQueue, reference for the benchmarks
+template<typename T>
+class HeapQueue {
+private:
+	std::priority_queue<std::pair<unsigned int, T>, std::vector<std::pair<unsigned int, T>>, std::greater<std::pair<unsigned int, T>>> m_heap;
+	unsigned int m_key;
+public:
+	HeapQueue() : m_key(0) {}
+
+	void reset(unsigned short /*maxStep*/) {
+		m_heap = decltype(m_heap)();
+		m_key = 0;
+	}
+	inline bool empty() const {
+		return m_heap.empty();
+	}
+	inline unsigned int key() const {
+		return m_key;
+	}
+	inline void push(unsigned int key, const T& value) {
+		m_heap.emplace(std::make_pair(key, value));
+	}
+	T pop() {
+		T value = m_heap.top().second;
+		m_key = m_heap.top().first;
+		m_heap.pop();
+		return value;
+	}
+};
 #endif
-	// save dist, adjacent tiles, cameFrom
-	// adjacentTiles: there may be islands, so for each start tile
-	void dijkstra(Tile* start, unsigned char id) {
-		// init queue
-		std::priority_queue<std::pair<unsigned short, Tile*>, std::vector<std::pair<unsigned short, Tile*>>, std::greater<std::pair<unsigned short, Tile*>>> q;
-		q.emplace(std::make_pair(0, start));
-		// init cameFrom
-		cameFrom[start->id] = start;
-		// init cost_so_far
-		costSoFar[start->id] = 0;
-		// init dist
-		distMap[start->id] = 0;
 
+class DijkstraSearch {
+private:
+	// search state of one tile, only valid if visited == generation of the search
+	// 6 bytes: the parent is stored as the index into the neighbours of the tile, generations wrap after 255 searches
+	struct Node {
+		unsigned short costSoFar;
+		unsigned short dist;
+		unsigned char cameFrom; // NORTH - 1 ... WEST - 1, NO_PARENT for the start
+		unsigned char visited;
+	};
+	static const unsigned char NO_PARENT = 4;
+	std::vector<Node> nodes;
+	unsigned char generation;
+	// frontier, bitset for membership and list for iteration
+	TileBitset adjacentMask;
+	std::vector<unsigned short> adjacentTiles;
+
+	inline bool known(unsigned short t) const {
+		return nodes[t].visited == generation;
+	}
+	inline unsigned short parent(const Grid& grid, unsigned short t) const {
+		return grid.neighbours(t)[nodes[t].cameFrom];
+	}
+	inline bool isAdjacent(unsigned short t) const {
+		return adjacentMask.test(t);
+	}
+	inline void addAdjacent(unsigned short t) {
+		if (!isAdjacent(t)) {
+			adjacentMask.set(t);
+			adjacentTiles.push_back(t);
+		}
+	}
+	// the list is compacted by compactAdjacent() before new tiles are added
+	inline void erase(unsigned short t) {
+		nodes[t].visited = 0;
+		adjacentMask.reset(t);
+	}
+	void compactAdjacent() {
+		adjacentTiles.erase(std::remove_if(adjacentTiles.begin(), adjacentTiles.end(), [this](unsigned short t) {
+			return !isAdjacent(t);
+		}), adjacentTiles.end());
+	}
+	template<class Queue>
+	void relax(const Grid& grid, Queue& q, unsigned char id) {
 		for (; !q.empty();) {
-			Tile* zone = q.top().second;
-			q.pop();
-
-			if (zone->owner == id) {
-				for (size_t i = 0; i < 4; i++) {
-					Tile* next = zone->neighbours[i];
-					unsigned short new_cost = costSoFar[zone->id] + next->cost();
-					unsigned short new_dist = distMap[zone->id] + 1;
-					if (!costSoFar.count(next->id) || new_cost < costSoFar[next->id] || (new_cost == costSoFar[next->id] && new_dist < distMap[next->id])) {
-						costSoFar[next->id] = new_cost;
-						cameFrom[next->id] = zone;
-						distMap[next->id] = new_dist;
-						if (next->owner == id) {
-							q.emplace(std::make_pair(new_cost, next));
+			unsigned short zone = q.pop();
+
+			if (grid.owner[zone] == id && nodes[zone].costSoFar == q.key()) { // skip outdated queue entries
+				const Node& z = nodes[zone];
+				const std::array<unsigned short, 4>& neighbours = grid.neighbours(zone);
+				for (unsigned char d = 0; d < 4; d++) {
+					unsigned short next = neighbours[d];
+					Node& n = nodes[next];
+					unsigned short new_cost = z.costSoFar + grid.cost(next);
+					unsigned short new_dist = z.dist + 1;
+					if (n.visited != generation || new_cost < n.costSoFar || (new_cost == n.costSoFar && new_dist < n.dist)) {
+						n.costSoFar = new_cost;
+						n.cameFrom = d ^ 2; // opposite direction
+						n.dist = new_dist;
+						n.visited = generation;
+						relaxations++;
+						if (grid.owner[next] == id) {
+							q.push(new_cost, next);
+							pushes++;
 						} else {
-							if (!adjacentTiles.count(next->id)) {
-								adjacentTiles[next->id] = next;
-							}
+							addAdjacent(next);
 						}
 					}
 				}
 			}
 		}
 	}
+	// save dist, adjacent tiles, cameFrom
+	// adjacentTiles: there may be islands, so for each start tile
+	template<class Queue>
+	void dijkstra(const Grid& grid, unsigned short start, unsigned char id) {
+		// init queue, one per thread and queue type, so the buckets are only allocated once
+		static thread_local Queue q;
+		q.reset(grid.maxProduction);
+		q.push(0, start);
+		pushes++;
+		// init cameFrom, cost_so_far and dist
+		nodes[start] = { 0, 0, NO_PARENT, generation };
+
+		relax(grid, q, id);
+	}
 	// from start tile to target tile
-	// at least 2 tiles
-	bool reconstructPath(Tile* target, std::vector<Tile*>& path) {
-		path.reserve(64);
-		Tile* current = target;
-		path.push_back(current);
-		while (!(*current == *start)) {
-			try {
-				current = cameFrom.at(current->id);
-			}
-			catch (...) {
-				path.clear();
+	// at least 2 tiles, written backwards into the arena as the length is dist + 1
+	bool reconstructPath(const Grid& grid, unsigned short target, PathArena& arena, PathSpan& path) {
+		if (!known(target)) {
+			return false;
+		}
+		size_t length = nodes[target].dist + 1;
+		// validate first, so rejected paths take no space of the arena
+		unsigned short current = target;
+		for (size_t i = length; i-- > 0;) {
+			if (!known(current) || (current == start) != (i == 0)) {
 				return false;
 			}
-			path.push_back(current);
+			if (i > 0) current = parent(grid, current);
 		}
-		std::reverse(path.begin(), path.end());
+		unsigned short* tiles = arena.allocate(length);
+		current = target;
+		for (size_t i = length; i-- > 0;) {
+			tiles[i] = current;
+			if (i > 0) current = parent(grid, current);
+		}
+		path = PathSpan(tiles, length);
 		return true;
 	}
 public:
-	Tile* start;
-	DijkstraSearch() {
-		start = nullptr;
+	unsigned short start;
+	unsigned int relaxations; // node updates of the last search or continuation (profiler)
+	unsigned int pushes; // queue pushes of the last search or continuation (profiler)
+
+	static const size_t ADJACENT_CANDIDATES = 8; // best adjacent tiles handed out per query
+
+	DijkstraSearch() : generation(0), relaxations(0), pushes(0) {
+		start = -1;
+	}
+	DijkstraSearch(const Grid& grid, unsigned short s, unsigned char id) : generation(0), relaxations(0), pushes(0) {
+		search(grid, s, id);
+	}
+
+	// mark the search as outdated (start = -1), the storage is kept for the next search
+	void invalidate() {
+		start = -1;
+	}
+	bool allocated() const {
+		return !nodes.empty();
+	}
+	// bytes of the storage
+	size_t memory() const {
+		return nodes.capacity() * sizeof(Node) + adjacentMask.memory() + adjacentTiles.capacity() * sizeof(unsigned short);
 	}
-	DijkstraSearch(Tile* s, std::vector< std::vector<Tile> >& gameMap, unsigned char width, unsigned char height, unsigned char id) : distMap(height*width, -1) {
+
+	// (re)compute the search from scratch, the storage of a previous search is reused
+	template<class Queue = BucketQueue<unsigned short>>
+	void search(const Grid& grid, unsigned short s, unsigned char id) {
+		if (nodes.size() != grid.size) {
+			nodes.assign(grid.size, Node());
+			adjacentMask.resize(grid.size);
+			generation = 0;
+		} else {
+			adjacentMask.clear();
+		}
+		adjacentTiles.clear();
+		if (++generation == 0) { // stamps wrapped around, invalidate all nodes explicitly
+			for (Node& n : nodes) {
+				n.visited = 0;
+			}
+			generation = 1;
+		}
 		start = s;
+		relaxations = 0;
+		pushes = 0;
+
+		dijkstra<Queue>(grid, start, id);
+	}
 
-		dijkstra(start, id);
+	// production cost of the cheapest path from start to t, -1 if t is not reached
+	inline unsigned short getCost(unsigned short t) const {
+		return known(t) ? nodes[t].costSoFar : -1;
 	}
 
-	std::vector<AdjacentTile> getAdjacentTiles(float penalty, unsigned char id, bool debug, std::ostream& out) {
+	// the best candidates sorted by value, scored from costSoFar and dist without their paths
+	// the path of a candidate is only walked when it is taken (setPath)
+	std::vector<AdjacentTile> getAdjacentTiles(const Grid& grid, float penalty, bool debug, std::ostream& out, size_t candidates = ADJACENT_CANDIDATES) {
 		std::vector<AdjacentTile> temp;
 		temp.reserve(adjacentTiles.size());
-		for (const std::pair<unsigned short, Tile*>& t : adjacentTiles) {
-			std::vector<Tile*> path;
-			bool reconstructed = reconstructPath(t.second, path);
-			if (!reconstructed) {
-				continue;
-			}
-			temp.push_back(AdjacentTile(start, t.second, distMap[t.first], path, penalty, id));
+		for (unsigned short t : adjacentTiles) {
+			// no tiles with strength > 0 && owner == 0 and enemy neighbours
+			if (grid.strength[t] > 0 && grid.owner[t] == 0 && grid.touchesEnemy(t)) continue;
+			temp.push_back(AdjacentTile(grid, start, t, nodes[t].dist, (unsigned short)(nodes[t].costSoFar - grid.production[t]), penalty));
 		}
 
+		if (temp.size() > candidates) {
+			std::nth_element(temp.begin(), temp.begin() + candidates, temp.end());
+			temp.resize(candidates);
+		}
 		sort(temp.begin(), temp.end());
 
 		if (debug && FULLDEBUG) {
 			out << "adjacent tiles: " << std::endl;
 			for (const auto& t : temp) {
-				out << t << std::endl;
+				t.print(out, grid);
+				out << std::endl;
 			}
 		}
 
-		// remove all tiles with strength > 0 && owner == 0 and enemy neighbours
-		temp.erase(std::remove_if(temp.begin(), temp.end(), [&id](const AdjacentTile& x) {
-			if (x.m_target->strength > 0 && x.m_target->owner == 0) {
-				for (Tile* t : x.m_target->neighbours) {
-					if (t->owner != id && t->owner != 0) {
-						return true;
-					}
-				}
-			}
-			return false;
-		}), temp.end());
-
 		return temp;
 	}
-	void dijkstraContinue(std::vector<TileChanged> changedTiles, unsigned char id) {
+	// adjacent tiles before the filter and the cut to the candidates
+	size_t adjacentCount() const {
+		return adjacentTiles.size();
+	}
+	bool setPath(const Grid& grid, AdjacentTile& tile, PathArena& arena) {
+		return reconstructPath(grid, tile.m_target, arena, tile.m_path);
+	}
+	// changedTiles must be sorted, new tiles first
+	void dijkstraContinue(const Grid& grid, const std::vector<TileChanged>& changedTiles, unsigned char id) {
 		// new tiles: find neighbour with min distance and insert this tile into the queue
 		// removed tiles: clean up all paths in cameFrom (and costSoFar) starting from this tile
 
 		// queue
-		std::priority_queue<std::pair<unsigned short, Tile*>, std::vector<std::pair<unsigned short, Tile*>>, std::greater<std::pair<unsigned short, Tile*>>> q;
-
-		sort(changedTiles.begin(), changedTiles.end(), [](const TileChanged& a, const TileChanged& b) {
-			return a.changed > b.changed;
-		});
+		static thread_local BucketQueue<unsigned short> q;
+		q.reset(grid.maxProduction);
+		relaxations = 0;
+		pushes = 0;
 
-		std::unordered_set<Tile*> checkIds;
+		std::vector<unsigned short> checkIds;
+		std::vector<unsigned short> removeTiles; // subtree of a removed tile, walked front to back
 		for (const TileChanged& tc : changedTiles) {
 			if (tc.changed == 1) { // new
-				unsigned short dist = -1;
-				for (Tile* n : tc.ref->neighbours) {
-					if (n->owner == id) {
-						checkIds.insert(n);
+				for (unsigned short n : grid.neighbours(tc.id)) {
+					if (grid.owner[n] == id) {
+						checkIds.push_back(n);
 					}
 				}
-				costSoFar.erase(tc.ref->id);
-				distMap[tc.ref->id] = -1;
-				cameFrom.erase(tc.ref->id);
-				adjacentTiles.erase(tc.ref->id);
+				erase(tc.id);
 			} else if (tc.changed == 2) { // removed
-				std::vector<Tile*> removeTiles;
-				removeTiles.reserve(8);
-				removeTiles.push_back(tc.ref);
-				while (!removeTiles.empty()) {
-					unsigned short removeId = removeTiles[0]->id;
-					costSoFar.erase(removeId);
-					distMap[removeId] = -1;
-					cameFrom.erase(removeId);
-					adjacentTiles.erase(removeId);
-
-					// queue all neighbours which are own tiles
-					for (Tile* n : removeTiles[0]->neighbours) {
-						if (n->owner == id) {
-							checkIds.insert(n);
+				removeTiles.clear();
+				removeTiles.push_back(tc.id);
+				for (size_t i = 0; i < removeTiles.size(); i++) {
+					unsigned short removeId = removeTiles[i];
+					erase(removeId);
+
+					for (unsigned short n : grid.neighbours(removeId)) {
+						// queue all neighbours which are own tiles
+						if (grid.owner[n] == id) {
+							checkIds.push_back(n);
 						}
-					}
-					for (const auto& p : cameFrom) {
-						if (p.second->id == removeId) {
-							for (Tile* n : removeTiles[0]->neighbours) {
-								if (n->id == p.first) {
-									removeTiles.push_back(n);
-									break;
-								}
-							}
+						// children in the shortest path tree are always neighbours, so the neighbour table is the child index
+						if (known(n) && nodes[n].cameFrom != NO_PARENT && parent(grid, n) == removeId) {
+							removeTiles.push_back(n);
 						}
 					}
-					removeTiles.erase(removeTiles.begin());
 				}
 			}
 		}
+		compactAdjacent();
 
-		for (Tile* n : checkIds) {
-			if (costSoFar.count(n->id)) {
-				q.emplace(std::make_pair(costSoFar[n->id], n));
+		for (unsigned short n : checkIds) {
+			if (known(n)) {
+				q.push(nodes[n].costSoFar, n);
+				pushes++;
 			}
 		}
 
 		// identical, see above
+		relax(grid, q, id);
+	}
+	bool isIdentical(const DijkstraSearch& other, bool debug, std::ostream& out) {
+		if (start != other.start) {
+			if (debug && FULLDEBUG) out << "Not identical: start failed!" << std::endl;
+			return false;
+		}
+		for (unsigned short t = 0; t < nodes.size(); t++) {
+			if (known(t) != other.known(t)) {
+				if (debug && FULLDEBUG) out << "Not identical: " << t << " visited failed!" << std::endl;
+				return false;
+			}
+			if (!known(t)) continue;
+			const Node& a = nodes[t];
+			const Node& b = other.nodes[t];
+			if (a.costSoFar != b.costSoFar) {
+				if (debug && FULLDEBUG) out << t << " => " << a.costSoFar << " | " << b.costSoFar << std::endl << "Not identical: costSoFar failed!" << std::endl;
+				return false;
+			}
+			if (a.dist != b.dist) {
+				if (debug && FULLDEBUG) out << "Not identical: distMap failed!" << std::endl;
+				return false;
+			}
+			if (a.cameFrom != b.cameFrom) {
+				if (debug && FULLDEBUG) out << "Not identical: cameFrom failed!" << std::endl;
+				return false;
+			}
+		}
+		if (adjacentMask != other.adjacentMask) {
+			if (debug && FULLDEBUG) out << "Not identical: adjacentTiles failed!" << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+	bool checkExpansion(const Grid& grid) {
+		for (unsigned short t : adjacentTiles) {
+			if (grid.owner[t] == 0 && grid.strength[t] == 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+// multi-source search from the frontier (targets = non own tiles next to own tiles) into the own territory,
+// replaces the DijkstraSearch per own tile on large territories, the work per frame grows linear with the territory
+// cost model of AdjacentTile: start s, intermediate own tiles i, target t -> (strength(t) + sum(production(i) + penalty)) / production(t)
+// the division by the production of the target is not additive, so there is one search per target production
+class FrontierPlanner {
+private:
+	struct Label {
+		float cost; // strength(t) + sum(production + penalty) from this tile (inclusive) to the target t (exclusive)
+		unsigned short next; // next tile on the way to the target
+	};
+	std::vector<unsigned char> m_productions; // target productions, one search each
+	std::vector< std::vector<Label> > m_labels; // per target production
+	std::vector<unsigned short> m_frontier;
+	std::vector<unsigned char> m_isFrontier;
+
+	// same filter as DijkstraSearch::getAdjacentTiles: no neutral tiles with strength > 0 and enemy neighbours
+	bool isTarget(const Grid& grid, unsigned short t) const {
+		return !(grid.strength[t] > 0 && grid.owner[t] == 0 && grid.touchesEnemy(t));
+	}
+	void search(const Grid& grid, std::vector<Label>& labels, unsigned char production, float penalty, unsigned char id) {
+		std::priority_queue<std::pair<float, unsigned short>, std::vector<std::pair<float, unsigned short>>, std::greater<std::pair<float, unsigned short>>> q;
+		labels.assign(grid.size, { std::numeric_limits<float>::infinity(), (unsigned short)-1 });
+
+		for (unsigned short t : m_frontier) {
+			if (grid.production[t] != production || !isTarget(grid, t)) continue;
+			for (unsigned short n : grid.neighbours(t)) {
+				float cost = grid.strength[t] + grid.production[n] + penalty;
+				if (grid.owner[n] == id && cost < labels[n].cost) {
+					labels[n] = { cost, t };
+					q.emplace(std::make_pair(cost, n));
+				}
+			}
+		}
+
 		for (; !q.empty();) {
-			Tile* zone = q.top().second;
+			float cost = q.top().first;
+			unsigned short zone = q.top().second;
 			q.pop();
+			if (cost != labels[zone].cost) continue; // outdated
 
-			if (zone->owner == id) {
-				for (size_t i = 0; i < 4; i++) {
-					Tile* next = zone->neighbours[i];
-					unsigned short new_cost = costSoFar[zone->id] + next->cost();
-					unsigned short new_dist = distMap[zone->id] + 1;
-					if (!costSoFar.count(next->id) || new_cost < costSoFar[next->id] || (new_cost == costSoFar[next->id] && new_dist < distMap[next->id])) {
-						costSoFar[next->id] = new_cost;
-						cameFrom[next->id] = zone;
-						distMap[next->id] = new_dist;
-						if (next->owner == id) {
-							q.emplace(std::make_pair(new_cost, next));
-						} else {
-							if (!adjacentTiles.count(next->id)) {
-								adjacentTiles[next->id] = next;
-							}
-						}
-					}
+			for (unsigned short n : grid.neighbours(zone)) {
+				float new_cost = cost + grid.production[n] + penalty;
+				if (grid.owner[n] == id && new_cost < labels[n].cost) {
+					labels[n] = { new_cost, zone };
+					q.emplace(std::make_pair(new_cost, n));
 				}
 			}
 		}
 	}
-	bool isIdentical(const DijkstraSearch& other, bool debug, std::ostream& out) {
-		if (start->id != other.start->id) {
-			if (debug && FULLDEBUG) out << "Not identical: start failed!" << std::endl;
-			return false;
+	PathSpan reconstructPath(const Grid& grid, const std::vector<Label>& labels, unsigned short start, unsigned short first, PathArena& arena, unsigned char id) const {
+		size_t length = 1;
+		for (unsigned short current = first; grid.owner[current] == id && length <= grid.size; current = labels[current].next) {
+			length++;
+		}
+		unsigned short* tiles = arena.allocate(length + 1);
+		tiles[0] = start;
+		unsigned short current = first;
+		for (size_t i = 1; i < length; i++) {
+			tiles[i] = current;
+			current = labels[current].next;
+		}
+		tiles[length] = current;
+		return PathSpan(tiles, length + 1);
+	}
+public:
+	size_t memory() const {
+		size_t bytes = m_productions.capacity() + m_frontier.capacity() * sizeof(unsigned short) + m_isFrontier.capacity();
+		for (const std::vector<Label>& labels : m_labels) {
+			bytes += labels.capacity() * sizeof(Label);
 		}
-		if (costSoFar != other.costSoFar) {
-			if (debug && FULLDEBUG) {
-				auto it2 = other.costSoFar.begin();
-#if FULLDEBUG
-				for (std::map<unsigned short, unsigned short>::iterator it1 = costSoFar.begin(); it1 != costSoFar.end(); ++it1, ++it2) {
-#else
-				for (std::unordered_map<unsigned short, unsigned short>::iterator it1 = costSoFar.begin(); it1 != costSoFar.end(); ++it1, ++it2) {
-#endif
-					out << it1->first << " => " << it1->second << " | " << it2->first << " => " << it2->second << std::endl;
+		return bytes;
+	}
+	// frontier of the current owners, returns the number of target productions (one search each)
+	size_t collectFrontier(const Grid& grid, const std::vector<unsigned short>& ownTiles, unsigned char id) {
+		m_isFrontier.assign(grid.size, 0);
+		m_frontier.clear();
+		std::array<bool, 256> productions = { false };
+		for (unsigned short t : ownTiles) {
+			for (unsigned short n : grid.neighbours(t)) {
+				if (grid.owner[n] != id && !m_isFrontier[n]) {
+					m_isFrontier[n] = 1;
+					m_frontier.push_back(n);
+					productions[grid.production[n]] = true;
 				}
-				out << "Not identical: costSoFar failed!" << std::endl;
 			}
-			return false;
 		}
-		if (distMap != other.distMap) {
-			if (debug && FULLDEBUG) out << "Not identical: distMap failed!" << std::endl;
-			return false;
+
+		m_productions.clear();
+		for (size_t p = 0; p < productions.size(); p++) {
+			if (productions[p]) m_productions.push_back((unsigned char)p);
 		}
-		if (!std::equal(cameFrom.begin(), cameFrom.end(), other.cameFrom.begin(), [](const std::pair<unsigned short, Tile*>& lhs, const std::pair<unsigned short, Tile*>& rhs) { return *(lhs.second) == *(rhs.second); })) {
-			if (debug && FULLDEBUG) out << "Not identical: cameFrom failed!" << std::endl;
-			return false;
+		return m_productions.size();
+	}
+	// the searches of the largest target productions of the frontier (collectFrontier), at most maxSearches
+	// returns the number of searches
+	size_t update(const Grid& grid, float penalty, unsigned char id, size_t maxSearches = -1) {
+		if (m_productions.size() > maxSearches) {
+			m_productions.erase(m_productions.begin(), m_productions.end() - maxSearches);
 		}
-		if (!std::equal(adjacentTiles.begin(), adjacentTiles.end(), other.adjacentTiles.begin(), [](const std::pair<unsigned short, Tile*>& lhs, const std::pair<unsigned short, Tile*>& rhs) { return *(lhs.second) == *(rhs.second); })) {
-			if (debug && FULLDEBUG) out << "Not identical: adjacentTiles failed!" << std::endl;
-			return false;
+		m_labels.resize(m_productions.size());
+		for (size_t i = 0; i < m_productions.size(); i++) {
+			search(grid, m_labels[i], m_productions[i], penalty, id);
 		}
+		return m_productions.size();
+	}
 
-		return true;
+	// best target of every searched production plus the targets next to start, sorted by value
+	std::vector<AdjacentTile> getAdjacentTiles(const Grid& grid, unsigned short start, float penalty, unsigned char id, PathArena& arena, bool debug, std::ostream& out) const {
+		std::vector<AdjacentTile> temp;
+		temp.reserve(m_productions.size() + 4);
+		for (unsigned short n : grid.neighbours(start)) {
+			if (grid.owner[n] != id && isTarget(grid, n)) {
+				unsigned short* path = arena.allocate(2);
+				path[0] = start;
+				path[1] = n;
+				temp.push_back(AdjacentTile(grid, start, n, 1, PathSpan(path, 2), penalty));
+			}
+		}
+		for (const std::vector<Label>& labels : m_labels) {
+			// the next tile of start itself avoids paths which return to start, targets next to start are already inserted
+			unsigned short first = labels[start].next;
+			if (first == (unsigned short)-1 || grid.owner[first] != id) continue;
+
+			PathSpan path = reconstructPath(grid, labels, start, first, arena, id);
+			temp.push_back(AdjacentTile(grid, start, path.back(), (unsigned short)(path.size() - 1), path, penalty));
+		}
+
+		sort(temp.begin(), temp.end());
+
+		if (debug && FULLDEBUG) {
+			out << "adjacent tiles (frontier planner): " << std::endl;
+			for (const auto& t : temp) {
+				t.print(out, grid);
+				out << std::endl;
+			}
+		}
+
+		return temp;
 	}
-	bool checkExpansion() {
-		for (const std::pair<unsigned short, Tile*>& t : adjacentTiles) {
-			if (t.second->owner == 0 && t.second->strength == 0) {
+	bool checkExpansion(const Grid& grid) const {
+		for (unsigned short t : m_frontier) {
+			if (grid.owner[t] == 0 && grid.strength[t] == 0) {
 				return false;
 			}
 		}
@@ -424,102 +1707,93 @@ public:
 
 class PathSearch {
 private:
-	inline bool canBeUsed(Tile* t, unsigned char turn, unsigned char moves) {
+	inline bool canBeUsed(unsigned short t, unsigned char turn, unsigned char moves) {
 		// use tile if a) not used 
 		// b) smaller turns or c) equal turns and smaller moves
-		if (t->used == -1 ||
-			turn < m_paths[0][t->used].m_turns ||
-			turn == m_paths[0][t->used].m_turns && (moves < m_paths[0][t->used].m_moves)) {
+		short u = m_grid->used[t];
+		if (u == -1 ||
+			turn < m_paths[0][u].m_turns ||
+			turn == m_paths[0][u].m_turns && (moves < m_paths[0][u].m_moves)) {
 			return true;
 		} else {
 			return false;
 		}
 	}
 public:
-	Tile* m_start;
+	unsigned short m_start;
 	AdjacentTile m_target;
-	unsigned char m_turns; // turns until the target is conquered, at least m_moves
-	unsigned char m_length; // how many tiles are included (not all tiles must be relevant), at least 1, maximum = path.size()-1
+	unsigned char m_turns; // turns until the target is conquered, at least m_moves (0 if not solved)
+	unsigned char m_length; // how many tiles are included (not all tiles must be relevant), at least 1, maximum = path.size()-1 (0 if not solved)
 	unsigned char m_moves; // how many moves until the target is reached = path.size()-1
 	std::vector<PathSearch>* m_paths;
+	Grid* m_grid;
 
-	PathSearch() :m_start(nullptr), m_paths(nullptr) {
+	PathSearch() :m_start(-1), m_turns(0), m_length(0), m_moves(0), m_paths(nullptr), m_grid(nullptr) {
 	}
-	PathSearch(Tile* start, AdjacentTile target, std::vector<PathSearch>& paths) : m_start(start), m_target(target), m_paths(&paths) {
+	PathSearch(Grid& grid, unsigned short start, AdjacentTile target, std::vector<PathSearch>& paths) : m_start(start), m_target(target), m_paths(&paths), m_grid(&grid) {
 		m_moves = target.m_path.size() - 1;
+		solve();
+	}
 
-		bool finished = false;
+	// m_turns and m_length from the smallest wait (0 - 255) at which the strength collected along the path beats the target
+	// returns false if no wait beats the target, m_turns and m_length are 0 then
+	bool solve() {
+		const PathSpan& path = m_target.m_path;
 		for (size_t wait = 0; wait < 256; wait++) {
 			unsigned short pathStrength = 0;
 
 			size_t k = wait;
 			for (m_length = 0; m_length < m_moves; m_length++, k++) {
-				Tile* t = target.m_path[m_length];
+				unsigned short t = path[m_length];
 				if (m_length == 0) { // always use the first tile
-					pathStrength += t->strength + (unsigned short)k * t->production;
+					pathStrength += m_grid->strength[t] + (unsigned short)k * m_grid->production[t];
 				} else {
 					if (!canBeUsed(t, m_moves + wait, m_moves)) break;
-					pathStrength += t->strength + (unsigned short)k * t->production;
+					pathStrength += m_grid->strength[t] + (unsigned short)k * m_grid->production[t];
 				}
 
-				if (pathStrength > m_target.m_target->strength) {
+				if (pathStrength > m_grid->strength[m_target.m_target]) {
 					m_length++;
 					m_turns = m_moves + wait;
-					finished = true;
-					break;
+					return true;
 				}
 			}
-
-
-			if (finished) break;
 		}
+		m_turns = 0;
+		m_length = 0;
+		return false;
 	}
-
-	PathSearch(const PathSearch& other) : m_start(other.m_start), m_target(other.m_target),
-		m_paths(other.m_paths), m_turns(other.m_turns), m_length(other.m_length), m_moves(other.m_moves)
-	{
-	}
-	void swap(PathSearch& other) {
-		std::swap(m_start, other.m_start);
-		std::swap(m_target, other.m_target);
-		std::swap(m_length, other.m_length);
-		std::swap(m_turns, other.m_turns);
-		std::swap(m_moves, other.m_moves);
-		std::swap(m_paths, other.m_paths);
-	}
-	PathSearch& operator=(PathSearch other) {
-		swap(other);
-
-		// by convention, always return *this
-		return *this;
+	// true if a wait beats the target (set by the constructor)
+	bool solved() const {
+		return m_length != 0;
 	}
 
-	bool update(std::vector<Tile*>& released, bool debug, std::ostream& out) {
+	bool update(std::vector<unsigned short>& released, bool debug, std::ostream& out) {
 		if (canBeUsed(m_target.m_path[0], m_turns, m_moves)) {
 			size_t insertId = m_paths[0].size();
 			released.reserve(m_length);
 
 			// check paths to release
 			for (size_t i = 0; i < m_length; i++) {
-				Tile* t = m_target.m_path[i];
+				unsigned short t = m_target.m_path[i];
 
 				if (debug && FULLDEBUG) {
-					out << i << "| " << *t << std::endl;
+					out << i << "| " << m_grid->print(t) << std::endl;
 				}
 
-				if (t->used != -1) {
-					unsigned short releaseId = t->used;
+				if (m_grid->used[t] != -1) {
+					unsigned short releaseId = m_grid->used[t];
 					for (size_t j = 0; j < m_paths[0][releaseId].m_length; j++) {
-						Tile* r = m_paths[0][releaseId].m_target.m_path[j];
-						r->used = -1;
-						r->move = -1;
+						unsigned short r = m_paths[0][releaseId].m_target.m_path[j];
+						m_grid->used[r] = -1;
+						m_grid->setMove(r, -1);
 						released.push_back(r);
 					}
 					m_paths[0][releaseId] = PathSearch();
 				}
 
-				t->used = insertId;
-				t->move = STILL;
+				m_grid->used[t] = insertId;
+				m_grid->setMove(t, STILL);
 			}
 
 			return true;
@@ -529,63 +1803,278 @@ public:
 	}
 
 	void print(std::ostream& out) {
-		if (m_start == nullptr) {
+		if (m_grid == nullptr) {
 			out << "empty" << std::endl;
 		} else {
-			out << "start:" << *m_start << " target:"  << " t:" << (int)m_turns << " l:" << (int)m_length << " m:" << (int)m_moves << " " << m_target << std::endl;
+			out << "start:" << m_grid->print(m_start) << " target:"  << " t:" << (int)m_turns << " l:" << (int)m_length << " m:" << (int)m_moves << " ";
+			m_target.print(out, *m_grid);
+			out << std::endl;
 		}
 	}
 };
+// paths are copied around a lot, they only hold spans into the PathArena
+static_assert(std::is_trivially_copyable<AdjacentTile>::value && std::is_trivially_copyable<PathSearch>::value, "paths must be trivially copyable");
 
-class GameState {
+class OverkillBotExtended {
 public:
-	std::vector< std::vector<Tile> > m_gameMap;
+	Grid m_grid;
 	unsigned char m_height;
 	unsigned char m_width;
 	unsigned char m_id;
 	unsigned char m_initialPlayers;
-	float m_movePenalty;
-	bool m_expansion;
 	unsigned int m_territorySize[7] = { 0 };
 	Timer m_timer;
-	std::vector<Tile*> m_ownTiles;
-	std::vector<DijkstraSearch> m_djikstraSearch;
-	std::vector<PathSearch> m_paths; // global paths, one Tile can be a path alone
+	std::vector<unsigned short> m_ownTiles;
+	std::vector<unsigned short> m_borderDistance; // steps from an own tile to the nearest other tile, computed on first use
 
-	GameState(const hlt::GameMap& gameMap, unsigned char myId) : m_width((unsigned char)gameMap.width), m_height((unsigned char)gameMap.height), m_id(myId), m_timer(),
-		m_expansion(true), m_djikstraSearch(m_height*m_width, DijkstraSearch())
+	// the bot lives for the whole game, topology and production are set up here, update() refreshes owners and strengths
+	OverkillBotExtended(const hlt::GameMap& gameMap, unsigned char myId, bool debug = false, std::ostream& out = std::cout) : m_grid(gameMap), m_height(m_grid.height), m_width(m_grid.width), m_id(myId), m_timer()
 	{
-		m_timer.startTimer(950);
-		m_gameMap = std::vector< std::vector<Tile> >(m_height, std::vector<Tile>(m_width));
-		for (unsigned char y = 0; y < m_height; y++) {
-			for (unsigned char x = 0; x < m_width; x++) {
-				const hlt::Site& s = gameMap.contents[y][x];
-				m_gameMap[y][x] = Tile(x, y, (unsigned char)s.owner, (unsigned char)s.strength, (unsigned char)s.production, m_width);
-
-				for (size_t i = 0; i < 4; i++) {
-					m_gameMap[y][x].neighbours[i] = getTile(&m_gameMap[y][x], CARDINALS[i]);
-				}
-			}
-		}
-		computeTerritorySize();
+		m_timer.startTimer(FRAME_TIME_LIMIT - FRAME_SAFETY_MARGIN);
+		m_grid.computeEnemyField(m_id);
+		init(debug, out);
 		m_initialPlayers = computePlayers();
-		m_ownTiles = getPlayerTiles(m_id);
+	}
+	// moves for a state which is already decoded, within the deadline of the given timer
+	OverkillBotExtended(const Grid& grid, unsigned char myId, const Timer& timer, bool debug = false, std::ostream& out = std::cout) : m_grid(grid), m_height(m_grid.height), m_width(m_grid.width), m_id(myId), m_timer(timer)
+	{
+		if (m_grid.fieldId != m_id) m_grid.computeEnemyField(m_id); // a decoded state comes with the field
+		init(debug, out);
+		m_initialPlayers = computePlayers();
+	}
+	void update(const hlt::GameMap& gameMap, bool debug = false, std::ostream& out = std::cout) {
+		m_timer.startTimer(FRAME_TIME_LIMIT - FRAME_SAFETY_MARGIN);
+		for (unsigned short t = 0; t < m_grid.size; t++) {
+			const hlt::Site& s = gameMap.contents[m_grid.y(t)][m_grid.x(t)];
+			m_grid.update(t, (unsigned char)s.owner, (unsigned char)s.strength);
+		}
+		m_grid.computeEnemyField(m_id);
+		init(debug, out);
+	}
+	// decoded state of the same map (with its enemy field) and the deadline of the given timer
+	void update(const Grid& grid, const Timer& timer, bool debug = false, std::ostream& out = std::cout) {
+		m_timer = timer;
+		m_grid.assignState(grid);
+		if (m_grid.fieldId != m_id) m_grid.computeEnemyField(m_id);
+		init(debug, out);
+	}
+	// per frame state
+	void init(bool debug, std::ostream& out) {
+		computeTerritorySize();
+		OwnerKernels::tiles(m_grid.owner.data(), m_grid.size, m_id, m_ownTiles);
+		m_borderDistance.clear();
+
+		if (debug) out << " Init OBE: " << m_timer << std::endl;
 
-		for (Tile* t : m_ownTiles) {
-			m_djikstraSearch[t->id] = DijkstraSearch(t, m_gameMap, m_width, m_height, m_id);
+		if (debug && FULLDEBUG) {
+			printMap(out);
 		}
 	}
 	void computeTerritorySize() {
+		OwnerKernels::histogram(m_grid.owner.data(), m_grid.size, m_territorySize);
+	}
+	unsigned char computePlayers() {
+		unsigned char num = 0;
 		for (size_t i = 0; i < 7; i++) {
-			m_territorySize[i] = 0;
+			if (m_territorySize[i]) {
+				num += 1;
+			}
+		}
+		return num;
+	}
+	unsigned short getTile(unsigned short t, unsigned char direction = STILL) {
+		return m_grid.getTile(t, direction);
+	}
+	std::vector<unsigned short> getPlayerTiles(unsigned char id) {
+		std::vector<unsigned short> tiles;
+		OwnerKernels::tiles(m_grid.owner.data(), m_grid.size, id, tiles);
+		return tiles;
+	}
+	void setMoveDirection(unsigned short t, unsigned short next) {
+		for (unsigned char c : CARDINALS) {
+			unsigned short n = getTile(t, c);
+			if (n == next) {
+				m_grid.setMove(t, c);
+				break;
+			}
+		}
+	}
+	bool isBorder(unsigned short t) {
+		return (m_grid.adjacency[t] & OwnerKernels::NEXT_TO_OTHER) != 0;
+	}
+
+	// multi-source BFS from the other tiles next to the territory through the own tiles, O(map) per frame
+	void computeBorderDistance() {
+		m_borderDistance.assign(m_grid.size, (unsigned short)-1);
+		std::vector<unsigned short> queue;
+		queue.reserve(m_grid.size);
+		for (unsigned short t = 0; t < m_grid.size; t++) {
+			if ((m_grid.adjacency[t] & (OwnerKernels::OWN | OwnerKernels::NEXT_TO_OWN)) == OwnerKernels::NEXT_TO_OWN) {
+				m_borderDistance[t] = 0;
+				queue.push_back(t);
+			}
+		}
+		for (size_t i = 0; i < queue.size(); i++) {
+			unsigned short t = queue[i];
+			for (unsigned short n : m_grid.neighbours(t)) {
+				if (m_grid.owner[n] == m_id && m_borderDistance[n] == (unsigned short)-1) {
+					m_borderDistance[n] = m_borderDistance[t] + 1;
+					queue.push_back(n);
+				}
+			}
+		}
+	}
+	// first step on a shortest way to the border (ties NORTH, EAST, SOUTH, WEST), NORTH if there is no border
+	unsigned char findNearestEnemyDirection(unsigned short t) {
+		if (m_borderDistance.empty()) computeBorderDistance();
+
+		unsigned char direction = NORTH;
+		unsigned short best = m_borderDistance[t];
+		for (unsigned char c : CARDINALS) {
+			unsigned short dist = m_borderDistance[m_grid.neighbours(t)[c - 1]];
+			if (dist < best) {
+				direction = c;
+				best = dist;
+			}
+		}
+
+		return direction;
+	}
+	float heuristic(unsigned short t, unsigned char str) {
+		if (m_grid.owner[t] == 0 && m_grid.strength[t] > 0) {
+			return (float)m_grid.production[t] / (float)m_grid.strength[t];
+		} else {
+			return m_grid.damage(t, str);
+		}
+	}
+	void move(unsigned short t, bool debug = false, std::ostream& out = std::cout) {
+		float damage = -1;
+		unsigned short target = -1;
+
+		for (unsigned short n : m_grid.neighbours(t)) {
+			if (m_grid.owner[n] != m_id) {
+				float d = heuristic(n, m_grid.strength[t]);
+				if (d > damage) {
+					damage = d;
+					target = n;
+				}
+			}
+		}
+
+		if (debug) out << m_grid.print(t);
+		if (debug && target != (unsigned short)-1) out << " target:" << m_grid.print(target);
+		if (debug) out << std::endl;
+
+		if (target != (unsigned short)-1 && m_grid.strength[target] < m_grid.strength[t]) {
+			setMoveDirection(t, target);
+			return;
+		}
+
+		if (m_grid.strength[t] < (m_grid.production[t] * 5)) {
+			m_grid.setMove(t, STILL);
+			return;
+		}
+
+		// if the cell isn't on the border
+		if (!isBorder(t)) {
+			m_grid.setMove(t, findNearestEnemyDirection(t));
+			return;
 		}
 
-		for (unsigned short i = 0; i < m_height; i++) {
-			for (unsigned short j = 0; j < m_width; j++) {
-				m_territorySize[m_gameMap[i][j].owner] += 1;
+		// otherwise wait until you can attack
+		m_grid.setMove(t, STILL);
+		return;
+	}
+
+	// moves of the given own tiles, stronger tiles first
+	void computeMoves(std::vector<unsigned short> tilesForMove, bool debug = false, std::ostream& out = std::cout) {
+		sort(tilesForMove.begin(), tilesForMove.end(), [this](unsigned short a, unsigned short b) {
+			return m_grid.strength[a] > m_grid.strength[b];
+		});
+
+		for (unsigned short t : tilesForMove) {
+			move(t, debug, out);
+
+			if (m_timer.timeCheck()) {
+				if (debug) out << "OBE TIME IS UP!" << std::endl;
+				break;
 			}
 		}
 	}
+
+	void computeMoves(MoveBuffer& moves, bool debug = false, std::ostream& out = std::cout) {
+		computeMoves(m_ownTiles, debug, out);
+
+		// set moves for response
+		moves.reset(*m_grid.topology);
+		for (unsigned short t : m_ownTiles) {
+			if (m_grid.move[t] > STILL) moves.set(t, (unsigned char)m_grid.move[t]);
+		}
+
+		if (debug) out << m_ownTiles.size() << " / " << m_timer << std::endl;
+	}
+
+	void printMap(std::ostream& out) {
+		m_grid.printMap(out);
+	}
+};
+
+class GameState {
+public:
+	Grid m_grid;
+	unsigned char m_height;
+	unsigned char m_width;
+	unsigned char m_id;
+	unsigned char m_initialPlayers;
+	float m_movePenalty;
+	bool m_expansion;
+	unsigned int m_territorySize[7] = { 0 };
+	FrameScheduler m_scheduler;
+	std::vector<unsigned short> m_ownTiles;
+	unsigned int m_ownProduction; // sum of the production of all own tiles
+	FrameChanges m_changes;
+	TileBitset m_isNew; // own tiles conquered in the last frame
+	std::vector<DijkstraSearch> m_djikstraSearch;
+	std::vector<DijkstraSearch> m_spareSearches; // storage of evicted searches for reuse
+	FrontierPlanner m_planner;
+	bool m_usePlanner; // frontier planner instead of one search per own tile
+	ThreadPool m_pool;
+	std::vector<PathSearch> m_paths; // global paths, one Tile can be a path alone
+	PathArena m_arena; // tiles of the paths of the current frame
+	MoveScheduler m_moveScheduler; // tiles waiting for their path
+	Profiler m_profiler;
+	TileBitset m_planned; // own tiles with a decision of the path planning in this frame
+	OverkillBotExtended m_overkill; // moves of the unplanned tiles
+	enum Zone : unsigned char { INTERIOR, FRONTIER, COMBAT, ZONES };
+	std::vector<unsigned char> m_zone; // zone of every own tile (classifyZones)
+	std::array<unsigned short, ZONES> m_zoneSize;
+
+	static const unsigned short PLANNER_TERRITORY = 400; // own tiles above which the frontier planner is used
+	static const size_t SEARCH_CHUNK_WORK = 20000; // tiles visited by the searches of one chunk of the thread pool
+	static const size_t SPARE_SEARCHES = 64; // evicted search storages kept over a frame
+
+	GameState(const hlt::GameMap& gameMap, unsigned char myId, double timeLimit = FRAME_TIME_LIMIT, double safetyMargin = FRAME_SAFETY_MARGIN) : m_grid(gameMap), m_height(m_grid.height), m_width(m_grid.width), m_id(myId),
+		m_expansion(true), m_scheduler(timeLimit, safetyMargin), m_djikstraSearch(m_grid.size, DijkstraSearch()), m_usePlanner(false),
+		m_overkill(m_grid, myId, m_scheduler.timer())
+	{
+		m_scheduler.startFrame();
+		m_grid.computeEnemyField(m_id);
+		computeTerritorySize();
+		m_initialPlayers = computePlayers();
+		m_ownTiles = getPlayerTiles(m_id);
+		classifyZones();
+		m_ownProduction = 0;
+		for (unsigned short t : m_ownTiles) {
+			m_ownProduction += m_grid.production[t];
+		}
+		m_isNew.resize(m_grid.size);
+		m_planned.resize(m_grid.size);
+
+		updateSearches(true, m_ownTiles.size());
+	}
+	void computeTerritorySize() {
+		OwnerKernels::histogram(m_grid.owner.data(), m_grid.size, m_territorySize);
+	}
 	unsigned char computePlayers() {
 		unsigned char num = 0;
 		for (size_t i = 0; i < 7; i++) {
@@ -596,72 +2085,134 @@ public:
 		return num;
 	}
 	float getMovePenalty() {
-		float penalty = 0;
-		for (Tile* t : m_ownTiles) {
-			penalty += t->production;
+		return m_ownProduction / (float)m_ownTiles.size();
+	}
+	// writes the new frame into the grid and collects the owner changes
+	void ingest(const hlt::GameMap& gameMap) {
+		m_changes.owners.clear();
+		for (unsigned short id = 0; id < m_grid.size; id++) {
+			const hlt::Site& s = gameMap.contents[m_grid.y(id)][m_grid.x(id)];
+			if (s.owner != m_grid.owner[id]) {
+				m_changes.owners.push_back({ id, m_grid.owner[id], (unsigned char)s.owner });
+			}
+			m_grid.update(id, (unsigned char)s.owner, (unsigned char)s.strength);
 		}
-		return penalty / (float)m_ownTiles.size();
 	}
-	void updateGameState() {
-		computeTerritorySize();
-		computePlayers();
-	}
-	void updateGameMap(const hlt::GameMap& gameMap, bool debug = false, std::ostream& out = std::cout) {
-		m_timer.startTimer(950);
-		std::vector<TileChanged> changedTiles;
-		for (unsigned char y = 0; y < m_height; y++) {
-			for (unsigned char x = 0; x < m_width; x++) {
-				const hlt::Site& s = gameMap.contents[y][x];
-				// check new or removed tiles
-				if (s.owner != m_gameMap[y][x].owner && (m_gameMap[y][x].owner == m_id || m_id == s.owner)) {
-					unsigned char c = 0;
-					if (m_id == s.owner) {
-						c = 1;
-					} else {
-						c = 2;
-					}
-					changedTiles.push_back(TileChanged(m_gameMap[y][x], c));
-				}
-				m_gameMap[y][x].update((unsigned char)s.owner, (unsigned char)s.strength);
+	void ingest(const FrameDecoder& decoder) {
+		m_changes.owners.clear();
+		decoder.decode(m_grid, m_changes.owners);
+	}
+	// territory sizes, own tiles, own production and new tiles from the owner changes alone
+	void applyChanges() {
+		for (const TileChanged& tc : m_changes.ownTiles) {
+			m_isNew.reset(tc.id);
+		}
+		m_changes.ownTiles.clear();
+
+		size_t removed = 0;
+		for (const FrameChanges::OwnerFlip& f : m_changes.owners) {
+			m_territorySize[f.from]--;
+			m_territorySize[f.to]++;
+			if (f.to == m_id) {
+				m_changes.ownTiles.push_back(TileChanged(f.id, 1));
+				m_ownProduction += m_grid.production[f.id];
+				m_isNew.set(f.id);
+			} else if (f.from == m_id) {
+				removed++;
+				m_ownProduction -= m_grid.production[f.id];
 			}
 		}
-		updateGameState();
-		m_ownTiles = getPlayerTiles(m_id);
+		size_t added = m_changes.ownTiles.size();
+		for (const FrameChanges::OwnerFlip& f : m_changes.owners) {
+			if (f.from == m_id) {
+				m_changes.ownTiles.push_back(TileChanged(f.id, 2));
+			}
+		}
+
+		// m_ownTiles stays sorted by id
+		if (removed) {
+			m_ownTiles.erase(std::remove_if(m_ownTiles.begin(), m_ownTiles.end(), [this](unsigned short t) {
+				return m_grid.owner[t] != m_id;
+			}), m_ownTiles.end());
+		}
+		if (added) {
+			size_t middle = m_ownTiles.size();
+			for (size_t i = 0; i < added; i++) {
+				m_ownTiles.push_back(m_changes.ownTiles[i].id);
+			}
+			std::inplace_merge(m_ownTiles.begin(), m_ownTiles.begin() + middle, m_ownTiles.end());
+		}
+	}
+	// the frame is a hlt::GameMap or a FrameDecoder holding the line of the engine
+	template<class Frame>
+	void updateGameMap(const Frame& frame, bool debug = false, std::ostream& out = std::cout) {
+		m_scheduler.startFrame();
+		m_profiler.endFrame(); // the previous frame ends with sending its moves
+		m_arena.reset();
+		m_scheduler.startPhase(FrameScheduler::INGEST);
+		{
+			ProfileScope profile(m_profiler, Profiler::INGEST);
+			ingest(frame);
+			applyChanges();
+			m_grid.computeEnemyField(m_id);
+			classifyZones();
+		}
+		m_scheduler.endPhase(m_grid.size);
 
 		if (debug && FULLDEBUG) {
+			unsigned int ownProduction = 0;
+			for (unsigned short t : getPlayerTiles(m_id)) {
+				ownProduction += m_grid.production[t];
+			}
+			if (m_ownTiles != getPlayerTiles(m_id) || ownProduction != m_ownProduction) {
+				out << "Differences in own tiles" << std::endl;
+			}
+
 			printMap(out);
 			printOwnTiles(out);
 
 			out << "new/removed files:" << std::endl;
-			for (const TileChanged& tc : changedTiles) {
-				out << tc << std::endl;
+			for (const TileChanged& tc : m_changes.ownTiles) {
+				tc.print(out, m_grid);
+				out << std::endl;
 			}
 		}
 
-		for (Tile* t : m_ownTiles) {
-			bool newTile = false;
-			for (const TileChanged& tc : changedTiles) {
-				if (tc.ref->id == t->id) {
-					newTile = true;
-				}
-			}
+		// switch to the frontier planner on large territories and back with hysteresis
+		bool usePlanner = m_ownTiles.size() > PLANNER_TERRITORY || (m_usePlanner && m_ownTiles.size() > PLANNER_TERRITORY / 2);
+		if (usePlanner && !m_usePlanner) {
+			m_djikstraSearch.assign(m_grid.size, DijkstraSearch()); // free the per tile searches
+			m_spareSearches.clear();
+		}
 
-			if (newTile) {
-				m_djikstraSearch[t->id] = DijkstraSearch(t, m_gameMap, m_width, m_height, m_id);
-			} else {
-				m_djikstraSearch[t->id].dijkstraContinue(changedTiles, m_id);
+		if (!usePlanner) {
+			// partial replanning if the searches and the paths of all tiles do not fit into the frame,
+			// both get time in proportion to their predicted cost
+			size_t searches = std::count_if(m_ownTiles.begin(), m_ownTiles.end(), [this](unsigned short t) { return needsSearch(t); });
+			double remaining = m_scheduler.remaining();
+			double searchCost = m_scheduler.predict(FrameScheduler::SEARCH, searches);
+			double pathCost = m_scheduler.predict(FrameScheduler::PATHS, m_ownTiles.size());
+			if (searchCost + pathCost > remaining) {
+				searches = (std::min)(searches, m_scheduler.affordable(FrameScheduler::SEARCH, remaining * searchCost / (searchCost + pathCost)));
 			}
+
+			m_scheduler.startPhase(FrameScheduler::SEARCH);
+			searches = updateSearches(m_usePlanner, searches); // searches were not continued while the planner was used
+			m_scheduler.endPhase(searches); // only the finished searches, the skipped ones cost nothing
+			if (debug) out << "searches: " << searches << " / " << m_ownTiles.size() << std::endl;
 		}
+		m_usePlanner = usePlanner;
 
-		if (debug && FULLDEBUG) {
-			std::vector<DijkstraSearch> m_djikstraSearchTemp(m_height*m_width, DijkstraSearch());
-			for (Tile* t : m_ownTiles) {
-				m_djikstraSearchTemp[t->id] = DijkstraSearch(t, m_gameMap, m_width, m_height, m_id);
+		if (debug && FULLDEBUG && !m_usePlanner) {
+			std::vector<DijkstraSearch> m_djikstraSearchTemp(m_grid.size, DijkstraSearch());
+			for (unsigned short t : m_ownTiles) {
+				if (m_djikstraSearch[t].start != t) continue; // missed the deadline
+				m_djikstraSearchTemp[t] = DijkstraSearch(m_grid, t, m_id);
 
-				const bool ident = m_djikstraSearchTemp[t->id].isIdentical(m_djikstraSearch[t->id], debug, out);
+				const bool ident = m_djikstraSearchTemp[t].isIdentical(m_djikstraSearch[t], debug, out);
 
 				if (!ident) {
-					out << "Differences in djikstra search with start tile id = " << t->id << std::endl;
+					out << "Differences in djikstra search with start tile id = " << t << std::endl;
 				}
 			}
 		}
@@ -669,132 +2220,235 @@ public:
 		m_paths.clear();
 		m_paths.reserve(m_ownTiles.size());
 		m_movePenalty = getMovePenalty();
+		if (m_usePlanner) {
+			// partial replanning like the searches: the planner and the paths share the frame in proportion to their cost,
+			// one planner search (one target production) visits all own tiles
+			size_t searches = m_planner.collectFrontier(m_grid, m_ownTiles, m_id);
+			double remaining = m_scheduler.remaining();
+			double plannerCost = m_scheduler.predict(FrameScheduler::PLANNER, searches * m_ownTiles.size());
+			double pathCost = m_scheduler.predict(FrameScheduler::PATHS, m_ownTiles.size());
+			if (plannerCost + pathCost > remaining) {
+				searches = (std::min)(searches, m_scheduler.affordable(FrameScheduler::PLANNER, remaining * plannerCost / (plannerCost + pathCost)) / m_ownTiles.size());
+				searches = (std::max)(searches, (size_t)1);
+			}
+
+			m_scheduler.startPhase(FrameScheduler::PLANNER);
+			{
+				ProfileScope profile(m_profiler, Profiler::PLANNER);
+				searches = m_planner.update(m_grid, m_movePenalty, m_id, searches);
+			}
+			m_scheduler.endPhase(searches * m_ownTiles.size());
+			if (debug) out << "planner searches: " << searches << std::endl;
+		}
 
 		// check expansion
-		if (m_expansion) {
-			for (Tile* t : m_ownTiles) {
-				m_expansion = m_djikstraSearch[t->id].checkExpansion();
+		if (m_expansion && m_usePlanner) {
+			m_expansion = m_planner.checkExpansion(m_grid);
+		} else if (m_expansion) {
+			for (unsigned short t : m_ownTiles) {
+				m_expansion = m_djikstraSearch[t].checkExpansion(m_grid);
 				if (!m_expansion) break;
 			}
 		}
 
-		if (debug) out << "expansion: " << m_expansion << " penalty: " << m_movePenalty << " Init: " << m_timer << std::endl;
+		m_profiler.memory(memory());
+		if (debug) out << "expansion: " << m_expansion << " penalty: " << m_movePenalty << " planner: " << m_usePlanner << " memory: " << memory() / 1024 << "kB Init: " << m_scheduler.timer() << std::endl;
+		if (debug) {
+			out << "threat:";
+			for (size_t p = 1; p < 7; p++) {
+				if (m_grid.threat[p]) out << " " << p << ":" << m_grid.threat[p];
+			}
+			out << std::endl;
+		}
+	}
+	// heap bytes of the searches, the planner and the paths
+	size_t memory() const {
+		size_t bytes = m_planner.memory() + m_arena.memory() + m_paths.capacity() * sizeof(PathSearch);
+		for (const DijkstraSearch& search : m_djikstraSearch) {
+			bytes += search.memory();
+		}
+		for (const DijkstraSearch& search : m_spareSearches) {
+			bytes += search.memory();
+		}
+		return bytes;
+	}
+	// combat tiles are next to an enemy or next to a tile next to an enemy (the gap between the players), they get the
+	// moves of OverkillBotExtended, frontier tiles are the other border tiles, the path planning is spent on frontier and interior
+	void classifyZones() {
+		m_zone.resize(m_grid.size);
+		m_zoneSize.fill(0);
+		for (unsigned short t : m_ownTiles) {
+			unsigned char zone = INTERIOR;
+			if (m_grid.touchesEnemy(t)) {
+				zone = COMBAT;
+			} else if (m_grid.adjacency[t] & OwnerKernels::NEXT_TO_OTHER) {
+				zone = FRONTIER;
+				for (unsigned short n : m_grid.neighbours(t)) {
+					if (m_grid.owner[n] != m_id && m_grid.touchesEnemy(n)) zone = COMBAT;
+				}
+			}
+			m_zone[t] = zone;
+			m_zoneSize[zone]++;
+		}
+	}
+	// tiles below the move threshold of computeMoves and combat tiles are never planned, so they need no search
+	// (m_expansion only turns false after the searches, which raises the threshold)
+	bool needsSearch(unsigned short t) const {
+		return m_zone[t] != COMBAT && m_grid.strength[t] != 0 && (m_expansion || m_grid.strength[t] > 8 * m_grid.production[t]);
+	}
+
+	// new or continued search for the given number of own tiles, in parallel on the thread pool
+	// the strongest tiles are updated as they are planned first, the searches of the others are invalidated
+	// searches which miss the deadline are invalidated too and recomputed in a later frame
+	// returns the number of searches which finished before the deadline
+	size_t updateSearches(bool restart, size_t searches) {
+		// the searches of tiles which will not move are evicted and recomputed from scratch once they can move again,
+		// their storage is reused by the tiles without one
+		std::vector<unsigned short> tiles;
+		tiles.reserve(m_ownTiles.size());
+		for (unsigned short t : m_ownTiles) {
+			DijkstraSearch& search = m_djikstraSearch[t];
+			if (needsSearch(t)) {
+				tiles.push_back(t);
+			} else if (search.allocated()) {
+				search.invalidate();
+				m_spareSearches.push_back(DijkstraSearch());
+				std::swap(m_spareSearches.back(), search);
+			}
+		}
+		for (unsigned short t : tiles) {
+			if (m_spareSearches.empty()) break;
+			if (!m_djikstraSearch[t].allocated()) {
+				std::swap(m_djikstraSearch[t], m_spareSearches.back());
+				m_spareSearches.pop_back();
+			}
+		}
+		if (m_spareSearches.size() > SPARE_SEARCHES) {
+			m_spareSearches.resize(SPARE_SEARCHES);
+		}
+
+		if (searches < tiles.size()) {
+			std::nth_element(tiles.begin(), tiles.begin() + searches, tiles.end(), [this](unsigned short a, unsigned short b) {
+				return m_grid.strength[a] > m_grid.strength[b];
+			});
+			for (size_t i = searches; i < tiles.size(); i++) {
+				m_djikstraSearch[tiles[i]].invalidate();
+			}
+			tiles.resize(searches);
+		}
+
+		// every search visits about the whole territory, so chunks get fewer searches on larger territories
+		size_t chunkSize = SEARCH_CHUNK_WORK / (std::max)(m_ownTiles.size(), (size_t)1);
+		chunkSize = (std::min)(chunkSize, (tiles.size() + 4 * m_pool.size() - 1) / (4 * m_pool.size())); // enough chunks to steal
+
+		std::atomic<size_t> completed(0);
+		m_pool.parallelFor(tiles.size(), chunkSize, [this, restart, &tiles, &completed](size_t i) {
+			unsigned short t = tiles[i];
+			DijkstraSearch& search = m_djikstraSearch[t];
+			if (m_scheduler.timeCheck()) {
+				search.invalidate();
+				return;
+			}
+
+			ProfileScope profile(m_profiler, Profiler::DIJKSTRA);
+			if (restart || search.start != t || m_isNew.test(t)) {
+				search.search(m_grid, t, m_id);
+			} else {
+				search.dijkstraContinue(m_grid, m_changes.ownTiles, m_id);
+			}
+			profile.count(search.relaxations, search.pushes);
+			completed.fetch_add(1, std::memory_order_relaxed);
+		});
+		return completed;
 	}
 
 	// Tile functions
 
-	Tile* getTile(Tile* t, unsigned char direction = STILL) {
-		unsigned char x = t->x, y = t->y;
-		if (direction != STILL) {
-			if (direction == NORTH) {
-				if (y == 0) y = m_height - 1;
-				else y--;
-			} else if (direction == EAST) {
-				if (x == m_width - 1) x = 0;
-				else x++;
-			} else if (direction == SOUTH) {
-				if (y == m_height - 1) y = 0;
-				else y++;
-			} else if (direction == WEST) {
-				if (x == 0) x = m_width - 1;
-				else x--;
-			}
-		}
-		return &m_gameMap[y][x];
+	unsigned short getTile(unsigned short t, unsigned char direction = STILL) {
+		return m_grid.getTile(t, direction);
 	}
 
 	// player functions
 
 	// sorted by id asc
-	std::vector<Tile*> getPlayerTiles(unsigned char id) {
-		std::vector<Tile*> tiles(0);
-		size_t k = 0;
-		for (unsigned short y = 0; y < m_height; y++) {
-			for (unsigned short x = 0; x < m_width; x++) {
-				if (m_gameMap[y][x].owner == id) {
-					tiles.push_back(&m_gameMap[y][x]);
-				}
-			}
-		}
-
-		sort(tiles.begin(), tiles.end(), [](Tile* a, Tile* b) {
-			return a->id < b->id;
-		});
-
+	std::vector<unsigned short> getPlayerTiles(unsigned char id) {
+		std::vector<unsigned short> tiles;
+		OwnerKernels::tiles(m_grid.owner.data(), m_grid.size, id, tiles);
 		return tiles;
 	}
 
 	// sorted by strength desc
-	std::vector<Tile*> getOwnBoarderTiles(unsigned char id) {
-		std::vector<Tile*> tiles(0);
-		for (Tile* t : m_ownTiles) {
+	std::vector<unsigned short> getOwnBoarderTiles(unsigned char id) {
+		std::vector<unsigned short> tiles(0);
+		for (unsigned short t : m_ownTiles) {
 			for (unsigned char c : CARDINALS) {
-				Tile* n = getTile(t, c);
-				if (n->owner != m_id) {
+				unsigned short n = getTile(t, c);
+				if (m_grid.owner[n] != m_id) {
 					tiles.push_back(t);
 				}
 			}
 		}
 
-		sort(tiles.begin(), tiles.end(), [](Tile* a, Tile* b) -> bool {
-			return a->strength > b->strength;
+		sort(tiles.begin(), tiles.end(), [this](unsigned short a, unsigned short b) -> bool {
+			return m_grid.strength[a] > m_grid.strength[b];
 		});
+
+		return tiles;
 	}
 
 	// own functions
 
-	void setMoveDirection(Tile* t, Tile* next) {
+	void setMoveDirection(unsigned short t, unsigned short next) {
 		for (unsigned char c : CARDINALS) {
-			Tile* n = getTile(t, c);
-			if (n->id == next->id) {
-				t->move = c;
+			unsigned short n = getTile(t, c);
+			if (n == next) {
+				m_grid.setMove(t, c);
 				break;
 			}
 		}
 	}
-	void setMoveForZeroStrengthTiles(std::vector<Tile*>& tiles) {
-		for (Tile* t : tiles) {
-			if (t->strength == 0) {
-				t->move = 0;
+	void setMoveForZeroStrengthTiles(std::vector<unsigned short>& tiles) {
+		for (unsigned short t : tiles) {
+			if (m_grid.strength[t] == 0) {
+				m_grid.setMove(t, STILL);
 			}
 		}
 	}
-	void setMoveForSmallStrengthTiles(std::vector<Tile*>& tiles, unsigned char multi) {
-		for (Tile* t : tiles) {
-			if (t->strength <= multi*t->production) {
-				t->move = 0;
+	void setMoveForSmallStrengthTiles(std::vector<unsigned short>& tiles, unsigned char multi) {
+		for (unsigned short t : tiles) {
+			if (m_grid.strength[t] <= multi*m_grid.production[t]) {
+				m_grid.setMove(t, STILL);
 			}
 		}
 	}
 
-	unsigned char getOppositeDirection(unsigned char d) {
-		if (d == 1 || d == 2) {
-			return d + 2;
-		} else {
-			return d - 2;
-		}
-	}
-	AdjacentTile getBestAdjacentTile(std::vector<AdjacentTile>& adjacentTiles) {
+	// search: sets the paths of candidates without one, candidates without a path are dropped
+	// returns a tile without path if there is no candidate
+	// first tile whose first step stays below the cap, capped is set if there is none (the least capped one is returned then)
+	AdjacentTile getBestAdjacentTile(std::vector<AdjacentTile>& adjacentTiles, DijkstraSearch* search, bool& capped) {
 		size_t i = 0, mi = 0, over = -1;
+		capped = false;
 
 		// check cap limit for next move
-		for (const AdjacentTile& t : adjacentTiles) {
-			Tile* s = t.m_path[0];
-			Tile* n = t.m_path[1];
+		for (size_t k = 0; k < adjacentTiles.size(); k++) {
+			AdjacentTile& t = adjacentTiles[k];
+			if (t.m_path.empty() && !search->setPath(m_grid, t, m_arena)) {
+				adjacentTiles.erase(adjacentTiles.begin() + k--);
+				continue;
+			}
+			unsigned short s = t.m_path[0];
+			unsigned short n = t.m_path[1];
 
-			// check multiple tile moves
-			unsigned short sum = s->strength;
-			for (unsigned char c : CARDINALS) {
-				Tile* o = getTile(n, c);
-				if (o->owner == m_id && s->id != o->id && o->move == getOppositeDirection(c)) {
-					sum += o->strength;
-				}
+			// check multiple tile moves: s and the strength already moving into n (without s)
+			unsigned short sum = m_grid.strength[s] + m_grid.incoming[n];
+			if (m_grid.move[s] > STILL && getTile(s, m_grid.move[s]) == n) {
+				sum -= m_grid.strength[s];
 			}
 
-			if (n->owner == m_id && (n->move == -1 || n->move == 0) && sum + n->strength + n->production > 255) {
-				if (sum + n->strength + n->production - 255 < over) {
+			if (m_grid.owner[n] == m_id && (m_grid.move[n] == -1 || m_grid.move[n] == 0) && sum + m_grid.strength[n] + m_grid.production[n] > 255) {
+				if (sum + m_grid.strength[n] + m_grid.production[n] - 255 < over) {
 					mi = i;
-					over = sum + n->strength + n->production - 255;
+					over = sum + m_grid.strength[n] + m_grid.production[n] - 255;
 				}
 				continue;
 			}
@@ -811,71 +2465,104 @@ public:
 			i++;
 		}
 
-		return adjacentTiles[mi];
+		capped = !adjacentTiles.empty();
+		return adjacentTiles.empty() ? AdjacentTile() : adjacentTiles[mi];
 	}
 
-	void computeMoves(std::set<hlt::Move>& moves, bool debug = false, std::ostream& out = std::cout) {
-		std::vector<Tile*> tilesForMove = m_ownTiles;
+	void computeMoves(MoveBuffer& moves, bool debug = false, std::ostream& out = std::cout) {
+		m_scheduler.startPhase(FrameScheduler::PATHS);
+		m_planned.clear();
+		std::vector<unsigned short> tilesForMove = m_ownTiles;
 		if (m_expansion) {
 			setMoveForZeroStrengthTiles(tilesForMove);
 		} else {
 			setMoveForSmallStrengthTiles(tilesForMove, 8);
 		}
-		// remove all STILL tiles
-		tilesForMove.erase(std::remove_if(tilesForMove.begin(), tilesForMove.end(), [](Tile* x) {
-			return x->move == 0;
-		}), tilesForMove.end());
-		// order by strength
-		sort(tilesForMove.begin(), tilesForMove.end(), [](Tile* a, Tile* b) {
-			return a->strength > b->strength;
-		});
+		// all but the STILL and combat tiles, ordered by strength
+		m_moveScheduler.reset(m_grid.size);
+		for (unsigned short t : tilesForMove) {
+			if (m_grid.move[t] != 0 && m_zone[t] != COMBAT) m_moveScheduler.push(t, m_grid.strength[t]);
+		}
 
+		// the overkill moves of the unplanned tiles need the rest of the frame
+		const double reserve = m_scheduler.predict(FrameScheduler::OVERKILL, m_ownTiles.size());
 		size_t counter = 0;
 		bool last = false;
-		while (!tilesForMove.empty()) {
-			Tile* start = tilesForMove[0];
-			tilesForMove.erase(tilesForMove.begin());
-			if (start->strength == 0 || (!m_expansion && start->strength <= 8*start->production)) continue; // dont move empty and small strength tiles (maybe queued because of other releases)
-
-			if (debug && FULLDEBUG) out << *start << std::endl;
+		while (!m_moveScheduler.empty()) {
+			unsigned short start = m_moveScheduler.pop();
+			if (m_grid.strength[start] == 0 || (!m_expansion && m_grid.strength[start] <= 8*m_grid.production[start])) { // dont move empty and small strength tiles (maybe queued because of other releases)
+				m_planned.set(start);
+				continue;
+			}
 
-			std::vector<AdjacentTile> adjacentTiles = m_djikstraSearch[start->id].getAdjacentTiles(m_movePenalty, m_id, debug, out);
-			if (adjacentTiles.size() != 0) {
-				AdjacentTile bestAdjacentTile = getBestAdjacentTile(adjacentTiles);
+			if (m_zone[start] == COMBAT) continue; // released by a path, left to the overkill moves
+			if (!m_usePlanner && m_djikstraSearch[start].start != start) continue; // search missed the deadline
+
+			if (debug && FULLDEBUG) out << m_grid.print(start) << std::endl;
+
+			AdjacentTile bestAdjacentTile;
+			{
+				ProfileScope profile(m_profiler, Profiler::ADJACENT_TILES);
+				std::vector<AdjacentTile> adjacentTiles = m_usePlanner ? m_planner.getAdjacentTiles(m_grid, start, m_movePenalty, m_id, m_arena, debug, out) :
+					m_djikstraSearch[start].getAdjacentTiles(m_grid, m_movePenalty, debug, out);
+				bool capped;
+				bestAdjacentTile = getBestAdjacentTile(adjacentTiles, m_usePlanner ? nullptr : &m_djikstraSearch[start], capped);
+				if (capped && !m_usePlanner && m_djikstraSearch[start].adjacentCount() > DijkstraSearch::ADJACENT_CANDIDATES) {
+					// all candidates are over the cap, the later ones may take another first step
+					adjacentTiles = m_djikstraSearch[start].getAdjacentTiles(m_grid, m_movePenalty, debug, out, std::numeric_limits<size_t>::max());
+					bestAdjacentTile = getBestAdjacentTile(adjacentTiles, &m_djikstraSearch[start], capped);
+				}
 
-				PathSearch best(start, bestAdjacentTile, m_paths);
+				if (debug && FULLDEBUG && !m_usePlanner) {
+					// the cut to the candidates must pick the same move as all adjacent tiles
+					std::vector<AdjacentTile> all = m_djikstraSearch[start].getAdjacentTiles(m_grid, m_movePenalty, false, out, std::numeric_limits<size_t>::max());
+					bool allCapped;
+					AdjacentTile reference = getBestAdjacentTile(all, &m_djikstraSearch[start], allCapped);
+					if (reference.m_path.empty() != bestAdjacentTile.m_path.empty() || (!reference.m_path.empty() &&
+						(reference.m_value != bestAdjacentTile.m_value || reference.m_path[1] != bestAdjacentTile.m_path[1]))) {
+						out << "Differences in the picked adjacent tile of " << start << std::endl;
+					}
+				}
+			}
+			if (!bestAdjacentTile.m_path.empty()) {
+				ProfileScope profile(m_profiler, Profiler::PATH_SEARCH);
+				PathSearch best(m_grid, start, bestAdjacentTile, m_paths);
 
 				if (debug && FULLDEBUG) {
 					out << "path search: " << std::endl;
 					best.print(out);
 				}
 
-				std::vector<Tile*> released(0);
-				bool update = best.update(released, debug, out);
+				if (best.solved()) { // otherwise no wait beats the target, the tile gets an overkill move
+					std::vector<unsigned short> released(0);
+					bool update = best.update(released, debug, out);
+					for (unsigned short r : released) {
+						m_planned.reset(r);
+					}
+					m_planned.set(start);
 
-				// first tile maybe move, must be after update
-				if (best.m_turns == best.m_moves) { // dont wait if turns == moves
-					setMoveDirection(best.m_target.m_path[0], best.m_target.m_path[1]);
-				}
+					// first tile maybe move, must be after update
+					if (best.m_turns == best.m_moves) { // dont wait if turns == moves
+						setMoveDirection(best.m_target.m_path[0], best.m_target.m_path[1]);
+					}
 
-				if (update) {
-					// insert into move vector
-					sort(released.begin(), released.end(), [](Tile* a, Tile* b) {
-						return a->strength > b->strength;
-					});
-					tilesForMove.insert(tilesForMove.end(), released.begin(), released.end());
+					if (update) {
+						// plan the released tiles after the queued ones
+						m_moveScheduler.nextBatch();
+						for (unsigned short r : released) {
+							m_moveScheduler.push(r, m_grid.strength[r]);
+						}
 
-					m_paths.push_back(best);
+						m_paths.push_back(best);
+					}
 				}
-			} else {
-				active = true;
 			}
 
 			if (debug && FULLDEBUG) {
 				printPaths(out);
 				out << "tiles for move: " << std::endl;
-				for (Tile* t : tilesForMove) {
-					out << *t << std::endl;
+				for (const MoveScheduler::Entry& e : m_moveScheduler.entries()) {
+					out << m_grid.print(e.id) << std::endl;
 				}
 				out << std::endl;
 			}
@@ -883,88 +2570,115 @@ public:
 			counter++;
 
 			// once again
-			if (!last && tilesForMove.empty()) {
-				std::vector<Tile*> tiles = m_ownTiles;
+			if (!last && m_moveScheduler.empty()) {
 				if (m_expansion) {
-					setMoveForZeroStrengthTiles(tiles);
+					setMoveForZeroStrengthTiles(tilesForMove);
 				} else {
-					setMoveForSmallStrengthTiles(tiles, 8);
+					setMoveForSmallStrengthTiles(tilesForMove, 8);
+				}
+				// all but the empty and combat tiles
+				m_moveScheduler.nextBatch();
+				for (unsigned short t : tilesForMove) {
+					if (m_grid.strength[t] != 0 && m_zone[t] != COMBAT) m_moveScheduler.push(t, m_grid.strength[t]);
 				}
-				// remove all STILL tiles
-				tiles.erase(std::remove_if(tiles.begin(), tiles.end(), [](Tile* x) {
-					return x->strength == 0;
-				}), tiles.end());
-				// order by strength
-				sort(tiles.begin(), tiles.end(), [](Tile* a, Tile* b) {
-					return a->strength > b->strength;
-				});
-
-				tilesForMove.insert(tilesForMove.begin(), tiles.begin(), tiles.end());
 				last = true;
 			}
 
-			if (m_timer.timeCheck()) {
+			if (m_scheduler.exhausted(reserve)) {
 				if (debug) out << counter << std::endl << "TIME IS UP!" << std::endl;
+				break;
+			}
+		}
+		m_scheduler.endPhase(counter);
 
-				if (counter == 1) active = true; // dijkstra needs to much time, use OverkillBotExtended
+		computeOverkillMoves(debug, out);
+		size_t cancelled = resolveCapWaste();
+		m_profiler.memory(memory()); // the paths of the frame are allocated now
 
-				break;
+		if (debug && FULLDEBUG) {
+			std::vector<unsigned short> incoming(m_grid.size, 0);
+			for (unsigned short t : m_ownTiles) {
+				if (m_grid.move[t] > STILL) incoming[getTile(t, m_grid.move[t])] += m_grid.strength[t];
+			}
+			if (incoming != m_grid.incoming) {
+				out << "Differences in incoming strength" << std::endl;
 			}
 		}
+		if (debug) out << "cap waste moves cancelled: " << cancelled << std::endl;
 
 		// set moves for response
-		for (Tile* t : m_ownTiles) {
-			moves.insert({ { t->x, t->y }, (unsigned char)(t->move == -1 ? STILL : t->move) });
+		ProfileScope profile(m_profiler, Profiler::MOVE_EMISSION);
+		moves.reset(*m_grid.topology);
+		for (unsigned short t : m_ownTiles) {
+			if (m_grid.move[t] > STILL) moves.set(t, (unsigned char)m_grid.move[t]);
+		}
+		if (debug) {
+			out << m_ownTiles.size() << " / " << m_scheduler.timer() << " scheduler ops: " << m_moveScheduler.operations() << " ";
+			m_scheduler.print(out);
+			out << std::endl;
 		}
-		if (debug) out << m_ownTiles.size() << " / " << m_timer << std::endl;
 	}
 
-	void printOwnTiles(std::ostream& out) {
-		out << "own tiles: " << std::endl;
-		printTiles(m_ownTiles, out);
-	}
-	void printTiles(std::vector<Tile*> tiles, std::ostream& out) {
-		for (Tile* t : tiles) {
-			out << *t << std::endl;
+	// a move whose strength is lost above the cap of 255 is cancelled if the tile it moves to reaches 255 without it,
+	// the strongest such move first, as long as the cancelled tile itself stays below the cap
+	size_t resolveCapWaste() {
+		size_t cancelled = 0;
+		for (unsigned short n = 0; n < m_grid.size; n++) {
+			if (m_grid.incoming[n] == 0) continue;
+			const bool stays = m_grid.owner[n] == m_id && m_grid.move[n] <= STILL;
+			for (;;) {
+				unsigned short total = m_grid.incoming[n] + (stays ? m_grid.strength[n] + m_grid.production[n] : 0);
+				if (total <= 255) break;
+
+				unsigned short cancel = -1;
+				for (unsigned short a : m_grid.neighbours(n)) {
+					if (m_grid.move[a] > STILL && getTile(a, m_grid.move[a]) == n && total - m_grid.strength[a] >= 255 &&
+						m_grid.incoming[a] + m_grid.strength[a] + m_grid.production[a] <= 255 &&
+						(cancel == (unsigned short)-1 || m_grid.strength[a] > m_grid.strength[cancel])) {
+						cancel = a;
+					}
+				}
+				if (cancel == (unsigned short)-1) break;
+				m_grid.setMove(cancel, STILL);
+				cancelled++;
+			}
 		}
+		return cancelled;
 	}
-	void printMap(std::ostream& out) {
-		out << "   ";
-		for (size_t j = 0; j < m_width; j++) {
-			out << "| " << std::setw(2) << j << " ";
-		}
-		out << "|" << std::endl;
-		out << "---";
-		for (size_t j = 0; j < m_width; j++) {
-			out << "-----";
-		}
-		out << "-" << std::endl;
-		for (size_t i = 0; i < m_height; i++) {
-			out << "   ";
-			for (size_t j = 0; j < m_width; j++) {
-				out << "|" << std::setw(4) << (int)m_gameMap[i][j].id;
-			}
-			out << "|" << std::endl;
 
-			out << std::setw(2) << i << " ";
-			for (size_t j = 0; j < m_width; j++) {
-				out << "|" << std::setw(1) << (int)m_gameMap[i][j].owner << "/" << std::setw(2) << (int)m_gameMap[i][j].production;
+	// combat tiles and tiles without a plan (deadline, missing search, no target) get the moves of OverkillBotExtended
+	void computeOverkillMoves(bool debug, std::ostream& out) {
+		std::vector<unsigned short> unplanned(0);
+		for (unsigned short t : m_ownTiles) {
+			if (!m_planned.test(t) && m_grid.move[t] == -1) {
+				unplanned.push_back(t);
 			}
-			out << "|" << std::endl;
+		}
+		if (unplanned.empty()) return;
 
-			out << "   ";
-			for (size_t j = 0; j < m_width; j++) {
-				out << "|" << std::setw(4) << (int)m_gameMap[i][j].strength;
-			}
-			out << "|" << std::endl;
+		m_scheduler.startPhase(FrameScheduler::OVERKILL);
+		m_overkill.update(m_grid, m_scheduler.timer());
+		m_overkill.computeMoves(unplanned, debug && FULLDEBUG, out);
+		for (unsigned short t : unplanned) {
+			m_grid.setMove(t, m_overkill.m_grid.move[t]);
+		}
+		m_scheduler.endPhase(unplanned.size());
 
-			out << "---";
-			for (size_t j = 0; j < m_width; j++) {
-				out << "-----";
-			}
-			out << "-" << std::endl;
+		if (debug) out << "overkill moves: " << unplanned.size() << " combat tiles: " << m_zoneSize[COMBAT] << " frontier: " << m_zoneSize[FRONTIER] << " interior: " << m_zoneSize[INTERIOR] << std::endl;
+	}
+
+	void printOwnTiles(std::ostream& out) {
+		out << "own tiles: " << std::endl;
+		printTiles(m_ownTiles, out);
+	}
+	void printTiles(std::vector<unsigned short> tiles, std::ostream& out) {
+		for (unsigned short t : tiles) {
+			out << m_grid.print(t) << std::endl;
 		}
 	}
+	void printMap(std::ostream& out) {
+		m_grid.printMap(out);
+	}
 	void printPaths(std::ostream& out) {
 		out << "global paths: " << std::endl;
 		for (PathSearch p : m_paths) {
@@ -1010,8 +2724,8 @@ public:
 		for (size_t i = 0; i < state.m_height; i++) {
 			os << std::setw(2) << i << " ";
 			for (size_t j = 0; j < state.m_width; j++) {
-				os << "| " << std::setw(3) << (int)state.m_gameMap[i][j].owner << " ";
-				//os << "| " << std::setw(3) << (int)state.m_gameMap[i][j].strength << " ";
+				os << "| " << std::setw(3) << (int)state.m_grid.owner[i*state.m_width + j] << " ";
+				//os << "| " << std::setw(3) << (int)state.m_grid.strength[i*state.m_width + j] << " ";
 			}
 			os << "|" << std::endl;
 
@@ -1025,247 +2739,578 @@ public:
 	}
 };
 
-class OverkillBotExtended {
-public:
-	std::vector< std::vector<Tile> > m_gameMap;
-	unsigned char m_height;
-	unsigned char m_width;
-	unsigned char m_id;
-	unsigned char m_initialPlayers;
-	unsigned int m_territorySize[7] = { 0 };
-	Timer m_timer;
-	std::vector<Tile*> m_ownTiles;
-
-	OverkillBotExtended(const hlt::GameMap& gameMap, unsigned char myId, bool debug = false, std::ostream& out = std::cout) : m_width((unsigned char)gameMap.width), m_height((unsigned char)gameMap.height), m_id(myId), m_timer()
-	{
-		m_timer.startTimer(950);
-		m_gameMap = std::vector< std::vector<Tile> >(m_height, std::vector<Tile>(m_width));
-		for (unsigned char y = 0; y < m_height; y++) {
-			for (unsigned char x = 0; x < m_width; x++) {
-				const hlt::Site& s = gameMap.contents[y][x];
-				m_gameMap[y][x] = Tile(x, y, (unsigned char)s.owner, (unsigned char)s.strength, (unsigned char)s.production, m_width);
-
-				for (size_t i = 0; i < 4; i++) {
-					m_gameMap[y][x].neighbours[i] = getTile(&m_gameMap[y][x], CARDINALS[i]);
-				}
-			}
+// replay dump of the bot (see RECORD): the lines the bot reads, player id, map size, productions and one map per frame
+// same format as the environment sends it, so a dump can be piped into the bot or read by the replay benchmark
+void recordInit(std::ostream& out, unsigned char myId, const hlt::GameMap& gameMap) {
+	out << (int)myId << std::endl << gameMap.width << " " << gameMap.height << std::endl;
+	for (unsigned short y = 0; y < gameMap.height; y++) {
+		for (unsigned short x = 0; x < gameMap.width; x++) {
+			out << (int)gameMap.contents[y][x].production << " ";
 		}
-		computeTerritorySize();
-		m_initialPlayers = computePlayers();
-		m_ownTiles = getPlayerTiles(m_id);
-
-		if (debug) out << " Init OBE: " << m_timer << std::endl;
-
-		if (debug && FULLDEBUG) {
-			printMap(out);
+	}
+	out << std::endl;
+}
+void recordFrame(std::ostream& out, const hlt::GameMap& gameMap) {
+	// owners run length encoded, then the strengths
+	unsigned short counter = 0;
+	unsigned char owner = gameMap.contents[0][0].owner;
+	for (unsigned short y = 0; y < gameMap.height; y++) {
+		for (unsigned short x = 0; x < gameMap.width; x++) {
+			if (gameMap.contents[y][x].owner != owner) {
+				out << counter << " " << (int)owner << " ";
+				counter = 0;
+				owner = gameMap.contents[y][x].owner;
+			}
+			counter++;
 		}
 	}
-	void computeTerritorySize() {
-		for (size_t i = 0; i < 7; i++) {
-			m_territorySize[i] = 0;
+	out << counter << " " << (int)owner;
+	for (unsigned short y = 0; y < gameMap.height; y++) {
+		for (unsigned short x = 0; x < gameMap.width; x++) {
+			out << " " << (int)gameMap.contents[y][x].strength;
 		}
+	}
+	out << std::endl;
+}
 
-		for (unsigned short i = 0; i < m_height; i++) {
-			for (unsigned short j = 0; j < m_width; j++) {
-				m_territorySize[m_gameMap[i][j].owner] += 1;
-			}
+#ifdef BENCHMARK
+// random map with one own territory of about territory * width * height tiles grown around the map center
+hlt::GameMap randomGameMap(unsigned char width, unsigned char height, float territory, std::mt19937& rng) {
+	hlt::GameMap gameMap(width, height);
+	std::uniform_int_distribution<int> production(0, 15), strength(0, 255);
+	for (unsigned short y = 0; y < height; y++) {
+		for (unsigned short x = 0; x < width; x++) {
+			gameMap.contents[y][x] = { 0, (unsigned char)strength(rng), (unsigned char)production(rng) };
 		}
 	}
-	unsigned char computePlayers() {
-		unsigned char num = 0;
-		for (size_t i = 0; i < 7; i++) {
-			if (m_territorySize[i]) {
-				num += 1;
-			}
+
+	std::vector<hlt::Location> border(1, hlt::Location{ (unsigned short)(width / 2), (unsigned short)(height / 2) });
+	gameMap.contents[height / 2][width / 2].owner = 1;
+	size_t size = 1, target = (size_t)(territory * width * height);
+	while (size < target && !border.empty()) {
+		size_t i = std::uniform_int_distribution<size_t>(0, border.size() - 1)(rng);
+		hlt::Location l = gameMap.getLocation(border[i], (unsigned char)std::uniform_int_distribution<int>(1, 4)(rng));
+		if (gameMap.getSite(l).owner == 0) {
+			gameMap.getSite(l).owner = 1;
+			border.push_back(l);
+			size++;
 		}
-		return num;
 	}
-	Tile* getTile(Tile* t, unsigned char direction = STILL) {
-		unsigned char x = t->x, y = t->y;
-		if (direction != STILL) {
-			if (direction == NORTH) {
-				if (y == 0) y = m_height - 1;
-				else y--;
-			} else if (direction == EAST) {
-				if (x == m_width - 1) x = 0;
-				else x++;
-			} else if (direction == SOUTH) {
-				if (y == m_height - 1) y = 0;
-				else y++;
-			} else if (direction == WEST) {
-				if (x == 0) x = m_width - 1;
-				else x--;
-			}
-		}
-		return &m_gameMap[y][x];
-	}
-	std::vector<Tile*> getPlayerTiles(unsigned char id) {
-		std::vector<Tile*> tiles(0);
-		size_t k = 0;
-		for (unsigned short y = 0; y < m_height; y++) {
-			for (unsigned short x = 0; x < m_width; x++) {
-				if (m_gameMap[y][x].owner == id) {
-					tiles.push_back(&m_gameMap[y][x]);
-				}
-			}
-		}
+	return gameMap;
+}
 
-		sort(tiles.begin(), tiles.end(), [](Tile* a, Tile* b) {
-			return a->id < b->id;
-		});
+// full searches for all own tiles, binary heap against bucket queue
+void benchmarkQueues(std::ostream& out) {
+	std::mt19937 rng(42);
+	out << "size  | own  | heap [ms] | bucket [ms] | speedup | equal costs" << std::endl;
+	for (unsigned char s = 20; s <= 50; s += 5) {
+		for (float territory : { 0.1f, 0.3f, 0.6f }) {
+			Grid grid(randomGameMap(s, s, territory, rng));
+			std::vector<unsigned short> own;
+			for (unsigned short t = 0; t < grid.size; t++) {
+				if (grid.owner[t] == 1) own.push_back(t);
+			}
 
-		return tiles;
-	}
-	void setMoveDirection(Tile* t, Tile* next) {
-		for (unsigned char c : CARDINALS) {
-			Tile* n = getTile(t, c);
-			if (n->id == next->id) {
-				t->move = c;
-				break;
+			std::vector<DijkstraSearch> heap(grid.size), bucket(grid.size);
+			auto t0 = std::chrono::high_resolution_clock::now();
+			for (unsigned short t : own) heap[t].search<HeapQueue<unsigned short>>(grid, t, 1);
+			auto t1 = std::chrono::high_resolution_clock::now();
+			for (unsigned short t : own) bucket[t].search<BucketQueue<unsigned short>>(grid, t, 1);
+			auto t2 = std::chrono::high_resolution_clock::now();
+
+			bool equal = true;
+			for (unsigned short t : own) {
+				for (unsigned short n = 0; n < grid.size; n++) {
+					equal = equal && heap[t].getCost(n) == bucket[t].getCost(n);
+				}
 			}
+
+			double heapMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+			double bucketMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+			out << std::setw(2) << (int)s << "x" << std::setw(2) << (int)s << " | " << std::setw(4) << own.size() << " | "
+				<< std::setw(9) << std::fixed << std::setprecision(2) << heapMs << " | " << std::setw(11) << bucketMs << " | "
+				<< std::setw(7) << heapMs / bucketMs << " | " << (equal ? "yes" : "NO") << std::endl;
 		}
 	}
-	bool isBorder(Tile* t) {
-		for (Tile* n : t->neighbours) {
-			if (n->owner != m_id) return true;
+}
+
+// owner plane kernels of every available level against the scalar ones, microseconds per call
+void benchmarkOwnerKernels(std::ostream& out) {
+	std::mt19937 rng(42);
+	const char* names[] = { "scalar", "sse2", "avx2" };
+	const OwnerKernels::Level best = OwnerKernels::level();
+	const int repetitions = 2000;
+	out << "size  | level  | histogram [us] | tiles [us] | adjacency [us] | equal" << std::endl;
+	for (unsigned char s : { 20, 23, 30, 37, 40, 50 }) {
+		std::shared_ptr<const Topology> topology = Topology::get(s, s);
+		std::vector<unsigned char> owner(topology->size);
+		std::uniform_int_distribution<int> player(1, 6);
+		for (unsigned char& o : owner) {
+			o = (unsigned char)(rng() % 2 ? 0 : player(rng));
+		}
+
+		unsigned int scalarCounts[7];
+		std::vector<unsigned short> scalarTiles;
+		std::vector<unsigned char> scalarFlags;
+		for (int level = OwnerKernels::SCALAR; level <= best; level++) {
+			OwnerKernels::level() = (OwnerKernels::Level)level;
+			unsigned int counts[7];
+			std::vector<unsigned short> tiles;
+			std::vector<unsigned char> flags;
+			auto t0 = std::chrono::high_resolution_clock::now();
+			for (int r = 0; r < repetitions; r++) OwnerKernels::histogram(owner.data(), topology->size, counts);
+			auto t1 = std::chrono::high_resolution_clock::now();
+			for (int r = 0; r < repetitions; r++) OwnerKernels::tiles(owner.data(), topology->size, (unsigned char)(1 + r % 6), tiles);
+			auto t2 = std::chrono::high_resolution_clock::now();
+			for (int r = 0; r < repetitions; r++) OwnerKernels::adjacency(*topology, owner.data(), (unsigned char)(1 + r % 6), flags);
+			auto t3 = std::chrono::high_resolution_clock::now();
+
+			if (level == OwnerKernels::SCALAR) {
+				std::copy(counts, counts + 7, scalarCounts);
+				scalarTiles = tiles;
+				scalarFlags = flags;
+			}
+			bool equal = std::equal(counts, counts + 7, scalarCounts) && tiles == scalarTiles && flags == scalarFlags;
+
+			out << std::setw(2) << (int)s << "x" << std::setw(2) << (int)s << " | " << std::setw(6) << names[level] << " | " << std::fixed << std::setprecision(3)
+				<< std::setw(14) << std::chrono::duration<double, std::micro>(t1 - t0).count() / repetitions << " | "
+				<< std::setw(10) << std::chrono::duration<double, std::micro>(t2 - t1).count() / repetitions << " | "
+				<< std::setw(14) << std::chrono::duration<double, std::micro>(t3 - t2).count() / repetitions << " | " << (equal ? "yes" : "NO") << std::endl;
 		}
-		return false;
+		OwnerKernels::level() = best;
 	}
+}
 
-	unsigned char findNearestEnemyDirection(Tile* t) {
-		unsigned char direction = NORTH;
-		unsigned char maxDistance = (std::min)(m_width, m_height) / 2;
+// frames which lose a large part of the territory, continued searches against new searches
+void benchmarkTerritoryLoss(std::ostream& out) {
+	std::mt19937 rng(42);
+	out << "size  | own  | lost | continue [ms] | new [ms] | equal costs" << std::endl;
+	for (unsigned char s = 20; s <= 50; s += 10) {
+		for (float lost : { 0.1f, 0.3f, 0.5f }) {
+			hlt::GameMap gameMap = randomGameMap(s, s, 0.5f, rng);
+			Grid grid(gameMap);
+			std::vector<DijkstraSearch> searches(grid.size);
+			for (unsigned short t = 0; t < grid.size; t++) {
+				if (grid.owner[t] == 1) searches[t].search(grid, t, 1);
+			}
 
-		for (unsigned char c : CARDINALS) {
-			unsigned char dist = 0;
-			Tile* current = t;
-			while (current->owner == m_id && dist < maxDistance) {
-				dist++;
-				current = current->neighbours[c-1];
+			// lose the rows at the top of the territory to an enemy
+			std::vector<TileChanged> changedTiles;
+			std::vector<unsigned short> own;
+			size_t ownBefore = 0;
+			for (unsigned short t = 0; t < grid.size; t++) {
+				ownBefore += grid.owner[t] == 1;
+			}
+			for (unsigned short t = 0; t < grid.size; t++) {
+				if (grid.owner[t] != 1) continue;
+				if (changedTiles.size() < lost * ownBefore) {
+					grid.owner[t] = 2;
+					changedTiles.push_back(TileChanged(t, 2));
+				} else {
+					own.push_back(t);
+				}
 			}
 
-			if (dist < maxDistance) {
-				direction = c;
-				maxDistance = dist;
+			auto t0 = std::chrono::high_resolution_clock::now();
+			for (unsigned short t : own) searches[t].dijkstraContinue(grid, changedTiles, 1);
+			auto t1 = std::chrono::high_resolution_clock::now();
+			std::vector<DijkstraSearch> fresh(grid.size);
+			for (unsigned short t : own) fresh[t].search(grid, t, 1);
+			auto t2 = std::chrono::high_resolution_clock::now();
+
+			bool equal = true;
+			for (unsigned short t : own) {
+				for (unsigned short n = 0; n < grid.size; n++) {
+					equal = equal && searches[t].getCost(n) == fresh[t].getCost(n);
+				}
 			}
+
+			out << std::setw(2) << (int)s << "x" << std::setw(2) << (int)s << " | " << std::setw(4) << ownBefore << " | " << std::setw(4) << changedTiles.size() << " | "
+				<< std::setw(13) << std::fixed << std::setprecision(2) << std::chrono::duration<double, std::milli>(t1 - t0).count() << " | "
+				<< std::setw(8) << std::chrono::duration<double, std::milli>(t2 - t1).count() << " | " << (equal ? "yes" : "NO") << std::endl;
 		}
+	}
+}
 
-		return direction;
+// recorded game, every player with own tiles in the first frame is benchmarked
+struct Replay {
+	std::string name;
+	std::vector<hlt::GameMap> frames;
+	std::vector<unsigned char> ids;
+};
+
+// bot dump (see recordFrame), the recorded player is benchmarked
+bool loadDump(const std::string& file, Replay& replay) {
+	std::ifstream in(file);
+	std::string id, size, productions, frame;
+	if (!std::getline(in, id) || !std::getline(in, size) || !std::getline(in, productions)) return false;
+	detail::deserializeMapSize(size);
+	detail::deserializeProductions(productions);
+	while (std::getline(in, frame)) {
+		if (!frame.empty()) replay.frames.push_back(detail::deserializeMap(frame));
 	}
-	float heuristic(Tile* t, unsigned char str) {
-		if (t->owner == 0 && t->strength > 0) {
-			return (float)t->production / (float)t->strength;
-		} else {
-			unsigned short damage = 0;
-			for (Tile* n : t->neighbours) {
-				if (n->owner != 0 && n->owner != m_id) {
-					damage += (std::min)(str, n->strength);
-				}
+	replay.ids.push_back((unsigned char)std::stoi(id));
+	return !replay.frames.empty();
+}
+
+// all integers of the json value which starts at the first '[' after key, in order
+std::vector<int> jsonIntegers(const std::string& json, const std::string& key) {
+	std::vector<int> values;
+	size_t pos = json.find("\"" + key + "\"");
+	if (pos == std::string::npos) return values;
+	pos = json.find('[', pos);
+	int depth = 0;
+	for (; pos < json.size(); pos++) {
+		char c = json[pos];
+		if (c == '[') {
+			depth++;
+		} else if (c == ']') {
+			if (--depth == 0) break;
+		} else if (c >= '0' && c <= '9') {
+			int v = 0;
+			for (; pos < json.size() && json[pos] >= '0' && json[pos] <= '9'; pos++) {
+				v = v * 10 + (json[pos] - '0');
 			}
-			return damage;
+			values.push_back(v);
+			pos--;
 		}
 	}
-	void move(Tile* t, bool debug = false, std::ostream& out = std::cout) {
-		float damage = -1;
-		Tile* target = nullptr;
+	return values;
+}
+int jsonInteger(const std::string& json, const std::string& key) {
+	size_t pos = json.find("\"" + key + "\"");
+	if (pos == std::string::npos) return -1;
+	pos = json.find_first_of("0123456789", pos + key.size() + 2);
+	return pos == std::string::npos ? -1 : std::stoi(json.substr(pos));
+}
 
-		for (Tile* n : t->neighbours) {
-			if (n->owner != m_id) {
-				float d = heuristic(n, t->strength);
-				if (d > damage) {
-					damage = d;
-					target = n;
+// Halite replay (.hlt json): width, height, productions[y][x], frames[f][y][x] = [owner, strength]
+bool loadHlt(const std::string& file, Replay& replay) {
+	std::ifstream in(file);
+	std::stringstream buffer;
+	buffer << in.rdbuf();
+	std::string json = buffer.str();
+
+	int width = jsonInteger(json, "width"), height = jsonInteger(json, "height");
+	if (width <= 0 || height <= 0) return false;
+	std::vector<int> productions = jsonIntegers(json, "productions");
+	std::vector<int> frames = jsonIntegers(json, "frames");
+	size_t tiles = (size_t)width * height;
+	if (productions.size() != tiles || frames.size() % (2 * tiles) != 0) return false;
+
+	std::array<bool, 256> players = { false };
+	for (size_t f = 0; f < frames.size() / (2 * tiles); f++) {
+		hlt::GameMap gameMap(width, height);
+		for (size_t i = 0; i < tiles; i++) {
+			hlt::Site& s = gameMap.contents[i / width][i % width];
+			s.owner = (unsigned char)frames[(f * tiles + i) * 2];
+			s.strength = (unsigned char)frames[(f * tiles + i) * 2 + 1];
+			s.production = (unsigned char)productions[i];
+			if (f == 0) players[s.owner] = true;
+		}
+		replay.frames.push_back(gameMap);
+	}
+	for (size_t p = 1; p < players.size(); p++) {
+		if (players[p]) replay.ids.push_back((unsigned char)p);
+	}
+	return !replay.frames.empty();
+}
+
+// frame latency (updateGameMap + computeMoves) of GameState over recorded games, no environment involved
+// files ending with .hlt are Halite replays, all others bot dumps
+void benchmarkReplays(const std::vector<std::string>& files, std::ostream& out) {
+	// latencies per map size and player count
+	std::map<std::pair<std::pair<int, int>, size_t>, std::vector<double>> latencies;
+	for (const std::string& file : files) {
+		Replay replay;
+		replay.name = file;
+		bool hlt = file.size() > 4 && file.compare(file.size() - 4, 4, ".hlt") == 0;
+		if (!(hlt ? loadHlt(file, replay) : loadDump(file, replay))) {
+			std::cerr << "could not load replay: " << file << std::endl;
+			continue;
+		}
+
+		std::array<bool, 256> players = { false };
+		for (const auto& row : replay.frames[0].contents) {
+			for (const hlt::Site& s : row) players[s.owner] = true;
+		}
+		size_t playerCount = std::count(players.begin() + 1, players.end(), true);
+		std::vector<double>& frameMs = latencies[std::make_pair(std::make_pair(replay.frames[0].width, replay.frames[0].height), playerCount)];
+
+		MoveBuffer moves;
+		for (unsigned char id : replay.ids) {
+			GameState gameState(replay.frames[0], id);
+			for (size_t f = 1; f < replay.frames.size(); f++) {
+				const hlt::GameMap& gameMap = replay.frames[f];
+				bool alive = false;
+				for (const auto& row : gameMap.contents) {
+					for (const hlt::Site& s : row) alive = alive || s.owner == id;
 				}
+				if (!alive) break;
+
+				auto t0 = std::chrono::high_resolution_clock::now();
+				gameState.updateGameMap(gameMap);
+				gameState.computeMoves(moves);
+				frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count());
 			}
 		}
+		out << file << ": " << replay.frames.size() << " frames, players " << replay.ids.size() << " / " << playerCount << std::endl;
+	}
 
-		if (debug) out << *t;
-		if (debug && target != nullptr) out << " target:" << *target;
-		if (debug) out << std::endl;
+	out << "size    | players | frames | p50 [ms] | p95 [ms] | max [ms]" << std::endl;
+	for (auto& l : latencies) {
+		std::vector<double>& ms = l.second;
+		if (ms.empty()) continue;
+		std::sort(ms.begin(), ms.end());
+		out << std::setw(3) << l.first.first.first << "x" << std::setw(3) << l.first.first.second << " | " << std::setw(7) << l.first.second << " | "
+			<< std::setw(6) << ms.size() << " | " << std::fixed << std::setprecision(2) << std::setw(8) << ms[(ms.size() - 1) / 2] << " | "
+			<< std::setw(8) << ms[(ms.size() - 1) * 95 / 100] << " | " << std::setw(8) << ms.back() << std::endl;
+	}
+}
 
-		if (target != nullptr && target->strength < t->strength) {
-			setMoveDirection(t, target);
-			return;
-		}
+// Halite I rules in process: production, 255 strength cap, simultaneous moves, merges and overkill combat on a torus
+// all buffers are allocated with the game, a step allocates nothing
+class HaliteSimulator {
+private:
+	struct Piece {
+		unsigned short tile;
+		unsigned char player;
+	};
+	std::shared_ptr<const Topology> m_topology;
+	unsigned char m_players;
+	std::vector<unsigned char> m_owner, m_strength, m_production;
+	std::vector<unsigned char> m_moves; // per tile, set by the owner
+	std::vector<short> m_pieces; // [player * size + tile], strength of the pieces after the moves, -1 none
+	std::vector<unsigned short> m_damage; // [player * size + tile]
+	std::vector<unsigned short> m_neutralDamage;
+	std::vector<Piece> m_occupied; // (player, tile) with a piece, capacity players * size
+	hlt::GameMap m_gameMap;
+	unsigned short m_turn;
+	unsigned short m_maxTurns;
 
-		if (t->strength < (t->production * 5)) {
-			t->move = STILL;
-			return;
+public:
+	// random map with smoothed productions (like the environment's) and the players spread over the map
+	HaliteSimulator(unsigned char width, unsigned char height, unsigned char players, unsigned int seed) : m_topology(std::make_shared<const Topology>(width, height)),
+		m_players(players), m_owner(m_topology->size, 0), m_strength(m_topology->size), m_production(m_topology->size), m_moves(m_topology->size, STILL),
+		m_pieces((players + 1) * m_topology->size, -1), m_damage((players + 1) * m_topology->size, 0), m_neutralDamage(m_topology->size, 0),
+		m_gameMap(width, height), m_turn(0), m_maxTurns((unsigned short)(10 * std::sqrt((double)width * height)))
+	{
+		m_occupied.reserve((players + 1) * m_topology->size);
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> uniform(0, 1);
+		std::vector<float> base(m_topology->size);
+		for (float& b : base) b = uniform(rng);
+		for (unsigned short t = 0; t < m_topology->size; t++) {
+			float s = base[t];
+			for (unsigned short n : m_topology->neighbours[t]) s += base[n];
+			s /= 5;
+			m_production[t] = (unsigned char)(s * s * 14 + (uniform(rng) < 0.7f ? 1 : 0));
+			m_strength[t] = (unsigned char)(std::min)(255.0f, uniform(rng) * 200 * s + 10);
+		}
+		for (unsigned char p = 0; p < players; p++) {
+			unsigned short x = (unsigned short)((p * width) / players + width / (2 * players)), y = (unsigned short)((height / 2 + p * 7) % height);
+			m_owner[y * width + x] = p + 1;
+			m_strength[y * width + x] = 255;
 		}
+	}
 
-		// if the cell isn't on the border
-		if (!isBorder(t)) {
-			t->move = findNearestEnemyDirection(t);
-			return;
+	unsigned short turn() const {
+		return m_turn;
+	}
+	unsigned short territory(unsigned char player) const {
+		return (unsigned short)std::count(m_owner.begin(), m_owner.end(), player);
+	}
+	bool finished() const {
+		unsigned char alive = 0;
+		for (unsigned char p = 1; p <= m_players; p++) {
+			alive += territory(p) > 0;
+		}
+		return alive <= 1 || m_turn >= m_maxTurns;
+	}
+	// the state as the environment sends it, the map is reused
+	const hlt::GameMap& gameMap() {
+		for (unsigned short t = 0; t < m_topology->size; t++) {
+			m_gameMap.contents[t / m_topology->width][t % m_topology->width] = { m_owner[t], m_strength[t], m_production[t] };
+		}
+		return m_gameMap;
+	}
+	// moves of tiles which are not owned by the player are ignored
+	void setMove(unsigned char player, unsigned short t, unsigned char direction) {
+		if (m_owner[t] == player) m_moves[t] = direction;
+	}
+	void setMoves(unsigned char player, const MoveBuffer& moves) {
+		for (unsigned short t : moves.moving()) {
+			setMove(player, t, moves.direction(t));
+		}
+	}
+	// flat buffer indexed by tile (like Grid::move), -1 is STILL
+	void setMoves(unsigned char player, const std::vector<signed char>& moves) {
+		for (unsigned short t = 0; t < m_topology->size; t++) {
+			if (moves[t] > 0) setMove(player, t, (unsigned char)moves[t]);
 		}
-
-		// otherwise wait until you can attack
-		t->move = STILL;
-		return;
 	}
 
-	void computeMoves(std::set<hlt::Move>& moves, bool debug = false, std::ostream& out = std::cout) {
-		std::vector<Tile*> tilesForMove = m_ownTiles;
-		sort(tilesForMove.begin(), tilesForMove.end(), [](Tile* a, Tile* b) {
-			return a->strength > b->strength;
-		});
-
-		for (Tile* t : tilesForMove) {
-			move(t, debug, out);
+	void step() {
+		const unsigned short size = m_topology->size;
 
-			if (m_timer.timeCheck()) {
-				if (debug) out << "OBE TIME IS UP!" << std::endl;
-				break;
+		// moves and production, pieces of one player on the same tile merge, a moving piece leaves a piece of strength 0
+		m_occupied.clear();
+		auto piece = [&](unsigned char p, unsigned short t) -> short& {
+			short& s = m_pieces[p * size + t];
+			if (s == -1) {
+				s = 0;
+				m_occupied.push_back({ t, p });
+			}
+			return s;
+		};
+		for (unsigned short t = 0; t < size; t++) {
+			unsigned char p = m_owner[t];
+			if (p == 0) continue;
+			if (m_moves[t] == STILL) {
+				short& s = piece(p, t);
+				s = (short)(std::min)(255, s + m_strength[t] + m_production[t]);
+			} else {
+				piece(p, t);
+				short& s = piece(p, m_topology->neighbours[t][m_moves[t] - 1]);
+				s = (short)(std::min)(255, s + m_strength[t]);
 			}
+			m_moves[t] = STILL;
 		}
 
-		// set moves for response
-		for (Tile* t : m_ownTiles) {
-			moves.insert({ { t->x, t->y }, (unsigned char)(t->move == -1 ? STILL : t->move) });
+		// every piece damages the enemy pieces on its tile and the adjacent tiles with its full strength (overkill),
+		// neutral tiles only fight the pieces on them
+		for (const Piece& pc : m_occupied) {
+			short s = m_pieces[pc.player * size + pc.tile];
+			for (int d = -1; d < 4; d++) {
+				unsigned short a = d < 0 ? pc.tile : m_topology->neighbours[pc.tile][d];
+				for (unsigned char o = 1; o <= m_players; o++) {
+					if (o != pc.player && m_pieces[o * size + a] != -1) m_damage[o * size + a] += s;
+				}
+			}
+			if (m_owner[pc.tile] == 0) {
+				m_neutralDamage[pc.tile] += s;
+				m_damage[pc.player * size + pc.tile] += m_strength[pc.tile];
+			}
 		}
 
-		if (debug) out << m_ownTiles.size() << " / " << m_timer << std::endl;
-	}
-
-	void printMap(std::ostream& out) {
-		out << "   ";
-		for (size_t j = 0; j < m_width; j++) {
-			out << "| " << std::setw(2) << j << " ";
-		}
-		out << "|" << std::endl;
-		out << "---";
-		for (size_t j = 0; j < m_width; j++) {
-			out << "-----";
+		// neutral tiles survive with their strength minus the damage, then the surviving pieces take the tiles
+		for (unsigned short t = 0; t < size; t++) {
+			if (m_owner[t] == 0) {
+				unsigned short damage = m_neutralDamage[t];
+				m_strength[t] = damage == 0 ? m_strength[t] : (damage >= m_strength[t] ? 0 : m_strength[t] - damage);
+				m_neutralDamage[t] = 0;
+			} else {
+				m_owner[t] = 0;
+				m_strength[t] = 0;
+			}
 		}
-		out << "-" << std::endl;
-		for (size_t i = 0; i < m_height; i++) {
-			out << "   ";
-			for (size_t j = 0; j < m_width; j++) {
-				out << "|" << std::setw(4) << (int)m_gameMap[i][j].id;
+		for (const Piece& pc : m_occupied) {
+			short& s = m_pieces[pc.player * size + pc.tile];
+			unsigned short& damage = m_damage[pc.player * size + pc.tile];
+			if (damage == 0 || damage < s) {
+				m_owner[pc.tile] = pc.player;
+				m_strength[pc.tile] = (unsigned char)(s - damage);
 			}
-			out << "|" << std::endl;
+			s = -1;
+			damage = 0;
+		}
+		m_turn++;
+	}
+};
 
-			out << std::setw(2) << i << " ";
-			for (size_t j = 0; j < m_width; j++) {
-				out << "|" << std::setw(1) << (int)m_gameMap[i][j].owner << "/" << std::setw(2) << (int)m_gameMap[i][j].production;
-			}
-			out << "|" << std::endl;
+// GameState or OverkillBotExtended in the simulator
+struct SelfPlayBot {
+	bool overkill;
+	unsigned char id;
+	std::unique_ptr<GameState> state;
+	std::unique_ptr<OverkillBotExtended> obe;
+	double ms;
+
+	SelfPlayBot(bool overkill, unsigned char id, const hlt::GameMap& gameMap) : overkill(overkill), id(id), state(overkill ? nullptr : new GameState(gameMap, id)),
+		obe(overkill ? new OverkillBotExtended(gameMap, id) : nullptr), ms(0) {}
+
+	void frame(const hlt::GameMap& gameMap, MoveBuffer& moves) {
+		auto t0 = std::chrono::high_resolution_clock::now();
+		if (overkill) {
+			obe->update(gameMap);
+			obe->computeMoves(moves);
+		} else {
+			state->updateGameMap(gameMap);
+			state->computeMoves(moves);
+		}
+		ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+	}
+};
 
-			out << "   ";
-			for (size_t j = 0; j < m_width; j++) {
-				out << "|" << std::setw(4) << (int)m_gameMap[i][j].strength;
+// games of GameState against OverkillBotExtended (bots alternate the seats) on random maps in the simulator
+// arguments: games, map size (0: random 20 - 40), players; a bot with a name of "dijkstra" or "overkill" plays against copies of itself
+void benchmarkSelfPlay(int games, int mapSize, int players, const std::string& bot, std::ostream& out) {
+	std::mt19937 rng(42);
+	std::array<int, 2> wins = { 0, 0 }; // GameState, OverkillBotExtended
+	double stepMs = 0, botMs = 0;
+	size_t steps = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int g = 0; g < games; g++) {
+		unsigned char size = (unsigned char)(mapSize ? mapSize : std::uniform_int_distribution<int>(4, 8)(rng) * 5);
+		HaliteSimulator sim(size, size, (unsigned char)players, rng());
+		std::vector<SelfPlayBot> bots;
+		for (int p = 0; p < players; p++) {
+			bool overkill = bot == "overkill" || (bot.empty() && (p + g) % 2 == 1);
+			bots.emplace_back(overkill, (unsigned char)(p + 1), sim.gameMap());
+		}
+
+		MoveBuffer moves;
+		while (!sim.finished()) {
+			const hlt::GameMap& gameMap = sim.gameMap();
+			for (SelfPlayBot& b : bots) {
+				if (sim.territory(b.id) == 0) continue;
+				b.frame(gameMap, moves);
+				sim.setMoves(b.id, moves);
 			}
-			out << "|" << std::endl;
+			auto t0 = std::chrono::high_resolution_clock::now();
+			sim.step();
+			stepMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+			steps++;
+		}
 
-			out << "---";
-			for (size_t j = 0; j < m_width; j++) {
-				out << "-----";
-			}
-			out << "-" << std::endl;
+		size_t winner = 0;
+		for (size_t p = 0; p < bots.size(); p++) {
+			if (sim.territory(bots[p].id) > sim.territory(bots[winner].id)) winner = p;
+			botMs += bots[p].ms;
+		}
+		wins[bots[winner].overkill]++;
+		out << "game " << g << ": " << (int)size << "x" << (int)size << " turns " << sim.turn() << " winner " << (bots[winner].overkill ? "overkill" : "dijkstra") << " territories";
+		for (const SelfPlayBot& b : bots) {
+			out << " " << sim.territory(b.id);
 		}
+		out << std::endl;
 	}
-};
+	double totalMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	out << "wins dijkstra: " << wins[0] << " overkill: " << wins[1] << std::endl;
+	out << std::fixed << std::setprecision(2) << "steps: " << steps << " step [us]: " << 1000 * stepMs / (std::max)(steps, (size_t)1)
+		<< " bots [ms]: " << botMs << " games per hour: " << games * 3600000.0 / totalMs << std::endl;
+}
 
+// build with -DBENCHMARK, the first argument selects the benchmark
+int main(int argc, char** argv) {
+	std::string benchmark = argc > 1 ? argv[1] : "queue";
+	if (benchmark == "queue") {
+		benchmarkQueues(std::cout);
+	} else if (benchmark == "loss") {
+		benchmarkTerritoryLoss(std::cout);
+	} else if (benchmark == "kernels") {
+		benchmarkOwnerKernels(std::cout);
+	} else if (benchmark == "replay") {
+		benchmarkReplays(std::vector<std::string>(argv + 2, argv + argc), std::cout);
+	} else if (benchmark == "selfplay") {
+		benchmarkSelfPlay(argc > 2 ? std::stoi(argv[2]) : 10, argc > 3 ? std::stoi(argv[3]) : 0, argc > 4 ? std::stoi(argv[4]) : 2, argc > 5 ? argv[5] : "", std::cout);
+	} else {
+		std::cerr << "unknown benchmark: " << benchmark << std::endl;
+		return 1;
+	}
+	return 0;
+}
+#else
 int main() {
     std::cout.sync_with_stdio(0);
 
@@ -1281,34 +3326,36 @@ int main() {
 	debugFile.open("debugOutput.dat");
 	if (!debugFile.is_open()) throw std::runtime_error("Could not open file for debug ouput");
 #endif
-    std::set<hlt::Move> moves;
+	std::ofstream profileFile("profile" + std::to_string((int)myId) + ".csv");
+	gameState.m_profiler.setOutput(&profileFile);
+#ifdef RECORD
+	std::ofstream recordFile("replay" + std::to_string((int)myId) + ".dump");
+	recordInit(recordFile, myId, presentMap);
+	recordFrame(recordFile, presentMap);
+#endif
+    MoveBuffer moves;
+	FrameDecoder decoder;
 	unsigned short frame = 0;
-    while(true) {
-        moves.clear();
-        getFrame(presentMap);
+    while(decoder.read(std::cin)) {
+#ifdef RECORD
+		recordFile << decoder.line() << std::endl; // same format as recordFrame
+#endif
 		
 #ifdef DEBUG
 		debugFile << "frame: " << frame << std::endl;
-		if (active) {
-			OverkillBotExtended obe(presentMap, myId, true, debugFile);
-			obe.computeMoves(moves, true, debugFile);
-		} else {
-			gameState.updateGameMap(presentMap, true, debugFile);
-			gameState.computeMoves(moves, true, debugFile);
-		}
+		gameState.updateGameMap(decoder, true, debugFile);
+		gameState.computeMoves(moves, true, debugFile);
 		debugFile.flush();
 #else
-		if (active) {
-			OverkillBotExtended obe(presentMap, myId);
-			obe.computeMoves(moves);
-		} else {
-			gameState.updateGameMap(presentMap);
-			gameState.computeMoves(moves);
-		}
+		gameState.updateGameMap(decoder);
+		gameState.computeMoves(moves);
 #endif
 
 		frame++;
-		sendFrame(moves);
+		{
+			ProfileScope profile(gameState.m_profiler, Profiler::SEND);
+			moves.send(std::cout);
+		}
     }
 
 #ifdef DEBUG
@@ -1316,4 +3363,4 @@ int main() {
 #endif
     return 0;
 }
-
+#endif